@@ -113,9 +113,40 @@ enum UninitializeReason {
 };
 
 
-// Debugging and error handling.
+// Modules of the DLL with a separately configurable diagnostics level.
+enum DiagModule {
+   DIAG_DEFAULT,                                            // all code not assigned to a module
+   DIAG_EXECUTIONCONTEXT,
+   DIAG_LOCK,
+   DIAG_LOG,
+   DIAG_TESTER,
+   DIAG_MODULES                                             // number of modules
+};
+
+#ifndef DIAG_MIN_LEVEL
+#define DIAG_MIN_LEVEL  LOG_DEBUG                           // diagnostics below this level are compiled out (set in the build config)
+#endif
+#ifndef DIAG_MODULE
+#define DIAG_MODULE     DIAG_DEFAULT                        // module of a source file (define before including "expander.h")
+#endif
+
+extern volatile LONG g_diagLevels[DIAG_MODULES];            // runtime diagnostics level per module
+
+
+// Debugging and error handling. Diagnostics are checked against the module's level before any argument is evaluated.
+#if DIAG_MIN_LEVEL <= LOG_DEBUG
+#define debug(...)             (g_diagLevels[DIAG_MODULE] <= LOG_DEBUG  ? _debug(__FILE__, __FUNCTION__, __LINE__, __VA_ARGS__) : 0)
+#define debugIn(module, ...)   (g_diagLevels[module]      <= LOG_DEBUG  ? _debug(__FILE__, __FUNCTION__, __LINE__, __VA_ARGS__) : 0)
+#else
+#define debug(...)             __noop(__VA_ARGS__)
+#define debugIn(module, ...)   __noop(__VA_ARGS__)
+#endif
+#if DIAG_MIN_LEVEL <= LOG_NOTICE
+#define notice(...)            (g_diagLevels[DIAG_MODULE] <= LOG_NOTICE ? _debug(__FILE__, __FUNCTION__, __LINE__, __VA_ARGS__) : 0)
+#else
+#define notice(...)            __noop(__VA_ARGS__)
+#endif
 #define dump(...)   _dump (__FILE__, __FUNCTION__, __LINE__, __VA_ARGS__)
-#define debug(...)  _debug(__FILE__, __FUNCTION__, __LINE__, __VA_ARGS__)
 #define warn(...)   _warn (__FILE__, __FUNCTION__, __LINE__, __VA_ARGS__)
 #define error(...)  _error(__FILE__, __FUNCTION__, __LINE__, __VA_ARGS__)
 
@@ -124,6 +155,9 @@ int WINAPI _debug(const char* fileName, const char* funcName, int line, const ch
 int WINAPI _warn (const char* fileName, const char* funcName, int line, int code, const char* format, ...);
 int WINAPI _error(const char* fileName, const char* funcName, int line, int code, const char* format, ...);
 
+BOOL WINAPI SetDiagLevel      (int level);
+BOOL WINAPI SetDiagModuleLevel(const char* module, int level);
+
 
 // Helper functions returning constant values. All parameters are ignored.
 inline int         WINAPI _EMPTY        (...) { return(EMPTY       ); }
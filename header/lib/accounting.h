@@ -0,0 +1,26 @@
+#pragma once
+#include "expander.h"
+#include "struct/mt4/FxtHeader.h"
+#include "struct/rsf/ExecutionContext.h"
+
+
+// accounting values of an open position (MQL: double[5]), all values in account currency
+struct POSITION_VALUES {
+   double profit;                                     // gross profit at the current price
+   double swap;                                       // accumulated swap
+   double commission;                                 // round-trip commission
+   double margin;                                     // required margin (hedged positions at the hedged rate)
+   double netProfit;                                  // profit + swap + commission
+};
+
+
+BOOL   WINAPI CheckAccountingModes(const FXT_HEADER* fxt);
+double WINAPI GetConversionRate  (const FXT_HEADER* fxt);
+uint   WINAPI GetSwapDays        (const FXT_HEADER* fxt, datetime from, datetime to);
+
+double WINAPI CalculateProfit    (const FXT_HEADER* fxt, int type, double lots, double openPrice, double closePrice);
+double WINAPI CalculateSwap      (const FXT_HEADER* fxt, int type, double lots, double price, datetime openTime, datetime time);
+double WINAPI CalculateCommission(const FXT_HEADER* fxt, double lots, double price);
+double WINAPI CalculateMargin    (const FXT_HEADER* fxt, double lots, double price);
+
+int    WINAPI Test_GetPositionValues(const EXECUTION_CONTEXT* ec, int tickets[], POSITION_VALUES values[], int size);
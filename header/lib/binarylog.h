@@ -0,0 +1,69 @@
+#pragma once
+#include "expander.h"
+#include "lib/log/LogFile.h"
+#include "struct/rsf/ExecutionContext.h"
+
+
+#define BINLOG_FILE_VERSION            1              // version of the binary log format
+#define BINLOG_MAX_ARGS              255              // max. number of arguments extracted from a message
+#define BINLOG_ARG_PLACEHOLDER      '\x01'            // marks the position of an argument in an interned message
+#define BINLOG_MAX_RECORD_SIZE   0x100000             // max. size of a record in bytes (1MB), longer text blocks are split
+
+// record types
+#define BINLOG_HEADER                  1              // start of a logging session (the dictionary is reset)
+#define BINLOG_DEFINITION              2              // definition of an interned string
+#define BINLOG_MESSAGE                 3              // a log message
+#define BINLOG_TEXT                    4              // a block of preformatted text lines
+
+// message flags
+#define BINLOG_TESTER                  1              // the message was logged in tester
+
+
+#pragma pack(push, 1)
+
+// common start of all records
+struct BINLOG_RECORD {
+   uint   size;                                       // record size in bytes including variable data
+   uchar  type;                                       // record type
+};
+
+// written at every opening of the logfile
+struct BINLOG_HEADER_RECORD {
+   uint   size;
+   uchar  type;                                       // BINLOG_HEADER
+   char   magic[8];                                   // "RSFBLOG"
+   uint   version;                                    // BINLOG_FILE_VERSION
+};
+
+// written before the first use of an interned string, followed by the string (not null-terminated)
+struct BINLOG_DEFINITION_RECORD {
+   uint   size;
+   uchar  type;                                       // BINLOG_DEFINITION
+   uint   id;                                         // id of the string (unique per logging session)
+};
+
+// a log message, followed by the arguments as a sequence of { uchar length; char text[length]; }
+struct BINLOG_MESSAGE_RECORD {
+   uint   size;
+   uchar  type;                                       // BINLOG_MESSAGE
+   uchar  flags;                                      // BINLOG_TESTER
+   uint64 time;                                       // tester: modeled time (Unix timestamp), online: local time (FILETIME)
+   int    level;                                      // loglevel
+   uint   pid;                                        // program id
+   uint   module;                                     // id of the interned execution path
+   uint   message;                                    // id of the interned message with the arguments cut out
+   int    error;                                      // error linked to the message (if any)
+   uchar  args;                                       // number of arguments
+};
+
+#pragma pack(pop)
+
+
+void WINAPI InitBinaryLog();
+void WINAPI ReleaseBinaryLog();
+
+BOOL WINAPI BinaryLog_Open      (LogFile* logger);
+BOOL WINAPI BinaryLog_Append    (const EXECUTION_CONTEXT* ec, LogFile* logger, datetime time, const char* message, int error, int level);
+BOOL WINAPI BinaryLog_AppendText(LogFile* logger, const char* text, uint size);
+void WINAPI BinaryLog_Release   (LogFile* logger);
+int  WINAPI BinaryLog_Decode    (const char* binaryFile, const char* outputFile);
@@ -0,0 +1,29 @@
+#pragma once
+#include "expander.h"
+
+
+#define LZ_MAX_BLOCK_SIZE         65536               // max. size of an uncompressed block (offsets are 16 bit)
+#define LZ_MIN_MATCH                  4               // min. length of a back-reference
+#define LZ_HASH_BITS                 12               // size of the match finder's hash table (4096 entries)
+#define LZ_BOUND(size) ((size) + (size)/255 + 16)     // max. compressed size of a block (incompressible data)
+
+#define LZ_BLOCK_MAGIC           "RSLZ"               // start of a block of a compressed logfile
+
+
+#pragma pack(push, 1)
+
+// a block of a compressed logfile, followed by the compressed data
+struct LZ_BLOCK_HEADER {
+   char   magic[4];                                   // LZ_BLOCK_MAGIC (not null-terminated)
+   uint   size;                                       // size of the compressed data
+   uint   rawSize;                                    // size of the uncompressed data (size==rawSize: the data is stored)
+   uint   checksum;                                   // FNV-1a hash of the compressed data
+};
+
+#pragma pack(pop)
+
+
+uint   WINAPI Lz_Compress      (const char* src, uint srcSize, char* dest, uint destSize);
+int    WINAPI Lz_Decompress    (const char* src, uint srcSize, char* dest, uint destSize);
+uint   WINAPI Lz_WriteBlock    (std::ostream &output, const char* data, uint size, char* buffer);
+double WINAPI Lz_DecompressFile(const char* compressedFile, const char* outputFile);
@@ -0,0 +1,147 @@
+#pragma once
+#include "expander.h"
+#include "lib/memory.h"
+
+
+#define LOGBUFFER_INITIAL_SIZE      4096              // initial arena size in bytes
+#define LOGBUFFER_MAX_SIZE      (1024*1024)           // default size cap in bytes
+
+
+/**
+ * A buffer for log entries of a program without an open logfile. Entries are stored back-to-back in a single growable arena,
+ * each terminated by a line break (log entries never contain line breaks). The whole buffer is written to a logfile with one
+ * call and reset without releasing single entries. If the size cap is reached the oldest entries are evicted.
+ */
+class LogBuffer {
+
+   /** The arena */
+   protected: char* m_data;
+
+   /** The arena size */
+   protected: uint m_capacity;
+
+   /** Offset of the oldest entry */
+   protected: uint m_begin;
+
+   /** Offset after the newest entry */
+   protected: uint m_end;
+
+   /** The number of buffered entries */
+   protected: uint m_entries;
+
+   /** The number of entries evicted since the last reset */
+   protected: uint m_evicted;
+
+   /** The size cap in bytes */
+   protected: uint m_maxSize;
+
+
+   /**
+    * Constructor
+    *
+    * @param  uint maxSize [optional] - size cap in bytes (default: LOGBUFFER_MAX_SIZE)
+    */
+   public: LogBuffer(uint maxSize = LOGBUFFER_MAX_SIZE) : m_data(NULL), m_capacity(0), m_begin(0), m_end(0), m_entries(0), m_evicted(0), m_maxSize(maxSize) {
+   }
+
+
+   /**
+    * Destructor
+    */
+   public: ~LogBuffer() {
+      free(m_data);
+   }
+
+
+   /**
+    * Return the number of buffered entries.
+    *
+    * @return uint
+    */
+   public: uint size() const {
+      return(m_entries);
+   }
+
+
+   /**
+    * Return the number of entries evicted since the last reset.
+    *
+    * @return uint
+    */
+   public: uint evicted() const {
+      return(m_evicted);
+   }
+
+
+   /**
+    * Return the buffered entries as a contiguous block of text.
+    *
+    * @return char* - text (not null-terminated), see length()
+    */
+   public: const char* data() const {
+      return(m_data + m_begin);
+   }
+
+
+   /**
+    * Return the length of the buffered text in bytes.
+    *
+    * @return uint
+    */
+   public: uint length() const {
+      return(m_end - m_begin);
+   }
+
+
+   /**
+    * Append an entry. If the size cap is exceeded the oldest entries are evicted. In steady state (arena at full size) the
+    * function doesn't allocate.
+    *
+    * @param  char* entry - entry text terminated by a line break
+    * @param  uint  size  - entry size in bytes including the line break
+    *
+    * @return BOOL - success status
+    */
+   public: BOOL append(const char* entry, uint size) {
+      if (size > m_maxSize) return(warn(ERR_INVALID_PARAMETER, "log entry too large for the log buffer: %d bytes (max %d)", size, m_maxSize));
+
+      while (m_entries && m_end-m_begin+size > m_maxSize) {          // evict the oldest entries
+         const char* next = (const char*)memchr(m_data + m_begin, '\n', m_end - m_begin);
+         m_begin = next ? next - m_data + 1 : m_end;
+         m_entries--;
+         m_evicted++;
+      }
+      if (!m_entries) m_begin = m_end = 0;
+
+      if (m_end + size > m_capacity) {
+         if (m_begin) {                                              // compact the arena
+            memmove(m_data, m_data + m_begin, m_end - m_begin);
+            m_end  -= m_begin;
+            m_begin = 0;
+         }
+         if (m_end + size > m_capacity) {                            // grow the arena
+            uint capacity = std::max(m_capacity*2, (uint)LOGBUFFER_INITIAL_SIZE);
+            while (capacity < m_end + size) capacity *= 2;
+            capacity = std::min(capacity, std::max(m_maxSize, m_end + size));
+
+            HotPath_CountAllocation();
+            char* data = (char*)realloc(m_data, capacity);
+            if (!data) return(error(ERR_OUT_OF_MEMORY, "realloc(%d) failed", capacity));
+            m_data     = data;
+            m_capacity = capacity;
+         }
+      }
+      memcpy(m_data + m_end, entry, size);
+      m_end += size;
+      m_entries++;
+      return(TRUE);
+   }
+
+
+   /**
+    * Remove all entries. The arena is kept for reuse.
+    */
+   public: void clear() {
+      m_begin = m_end = m_entries = m_evicted = 0;
+   }
+};
@@ -0,0 +1,102 @@
+#pragma once
+#include "expander.h"
+
+
+/**
+ * A vector-like container with stable element addresses and lock-free reads. Elements are stored in fixed-size segments
+ * which are allocated on demand and never moved, so a reader never sees a re-allocation in flight. An element is published
+ * by incrementing the size after it was fully written.
+ *
+ * Writers (push_back) must be synchronized by the caller. Readers need no synchronization.
+ */
+template <class T, uint SEGMENT_SIZE = 256, uint MAX_SEGMENTS = 256>
+class SegmentedVector {
+
+   /** The element segments (never moved once allocated) */
+   protected: T* volatile m_segments[MAX_SEGMENTS];
+
+   /** The number of published elements */
+   protected: volatile LONG m_size;
+
+
+   /**
+    * Constructor
+    *
+    * @param  uint size [optional] - number of initial default-constructed elements (default: none)
+    */
+   public: SegmentedVector(uint size = 0) : m_size(0) {
+      for (uint i=0; i < MAX_SEGMENTS; ++i) m_segments[i] = NULL;
+      for (uint i=0; i < size; ++i) push_back(T());
+   }
+
+
+   /**
+    * Destructor
+    */
+   public: ~SegmentedVector() {
+      for (uint i=0; i < MAX_SEGMENTS; ++i) delete[] m_segments[i];
+   }
+
+
+   /**
+    * Return the number of published elements.
+    *
+    * @return uint
+    */
+   public: uint size() const {
+      return(m_size);
+   }
+
+
+   /**
+    * Whether the container is full and push_back() would fail.
+    *
+    * @return bool
+    */
+   public: bool full() const {
+      return((uint)m_size >= SEGMENT_SIZE * MAX_SEGMENTS);
+   }
+
+
+   /**
+    * Return the element at the specified index. The index must be smaller than size().
+    *
+    * @param  uint index
+    *
+    * @return T&
+    */
+   public: T& operator[](uint index) {
+      return(m_segments[index / SEGMENT_SIZE][index % SEGMENT_SIZE]);
+   }
+
+
+   /**
+    * Return the element at the specified index. The index must be smaller than size().
+    *
+    * @param  uint index
+    *
+    * @return const T&
+    */
+   public: const T& operator[](uint index) const {
+      return(m_segments[index / SEGMENT_SIZE][index % SEGMENT_SIZE]);
+   }
+
+
+   /**
+    * Append an element and publish it to readers. Calls must be synchronized by the caller.
+    *
+    * @param  T value
+    *
+    * @return uint - index of the new element or EMPTY (-1) if the container is full
+    */
+   public: uint push_back(const T &value) {
+      uint index = m_size, segment = index / SEGMENT_SIZE;
+      if (segment >= MAX_SEGMENTS) return(_EMPTY(error(ERR_RUNTIME_ERROR, "SegmentedVector full (%d elements)", index)));
+
+      if (!m_segments[segment]) m_segments[segment] = new T[SEGMENT_SIZE];
+      m_segments[segment][index % SEGMENT_SIZE] = value;
+
+      InterlockedIncrement(&m_size);                           // full barrier: the element is visible before the new size
+      return(index);
+   }
+};
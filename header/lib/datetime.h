@@ -9,3 +9,7 @@ const char* WINAPI GmtTimeFormatA(datetime timestamp, const char* format);
 size_t      WINAPI localtimeFormat(char* buffer, size_t bufSize, datetime timestamp, const char* format);
 size_t      WINAPI localtimeFormat(char* buffer, size_t bufSize, SYSTEMTIME st, const char* format);
 const char* WINAPI LocalTimeFormatA(datetime timestamp, const char* format);
+
+void        WINAPI InitTimeFormatCache();
+void        WINAPI ReleaseTimeFormatCache();
+void        WINAPI ReleaseThreadTimeFormatCache();
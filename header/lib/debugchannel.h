@@ -0,0 +1,40 @@
+#pragma once
+#include "expander.h"
+
+
+#define DEBUGCHANNEL_SLOTS          2048              // number of messages kept in the ring (a power of 2)
+#define DEBUGCHANNEL_SLOT_SIZE      1024              // size of a ring slot in bytes (longer messages are truncated)
+#define DEBUGCHANNEL_HEADER_SIZE      64              // offset of the first ring slot in the shared memory section
+#define DEBUGCHANNEL_NAME  "Local\\rsfMT4Expander.DebugChannel.%d"     // name of the shared memory section (param: process id)
+
+// debug output sinks
+#define DEBUG_SINK_CHANNEL             1              // the shared memory debug channel
+#define DEBUG_SINK_DEBUGGER            2              // OutputDebugString()
+
+
+// a message in the ring
+struct DEBUGCHANNEL_SLOT {
+   volatile LONG sequence;                            // sequence number of the message + 1 (0: the slot is being written)
+   uint          length;                              // message length
+   char          text[DEBUGCHANNEL_SLOT_SIZE-8];      // message (null-terminated)
+};
+
+// start of the shared memory section, followed by the ring slots
+struct DEBUGCHANNEL_HEADER {
+   char          magic[8];                            // "RSFDBG"
+   uint          slots;                               // DEBUGCHANNEL_SLOTS
+   uint          slotSize;                            // DEBUGCHANNEL_SLOT_SIZE
+   DWORD         processId;                           // id of the writing process
+   volatile LONG sequence;                            // number of messages claimed by writers
+};
+
+
+extern volatile LONG g_debugSinks;                    // active debug output sinks
+
+void               WINAPI InitDebugChannel();
+void               WINAPI ReleaseDebugChannel();
+
+DEBUGCHANNEL_SLOT* WINAPI DebugChannel_Claim(LONG &sequence);
+void               WINAPI DebugChannel_Commit(DEBUGCHANNEL_SLOT* slot, LONG sequence, uint length);
+BOOL               WINAPI SetDebugSinks(int sinks);
+void               CALLBACK DebugChannel_Tail(HWND hWnd, HINSTANCE hInstance, char* cmdLine, int cmdShow);
@@ -1,5 +1,7 @@
 #pragma once
 #include "expander.h"
+#include "lib/trigger.h"
+#include "lib/log/LogFilter.h"
 #include "struct/rsf/ExecutionContext.h"
 
 
@@ -15,10 +17,14 @@ int                WINAPI LeaveContext          (EXECUTION_CONTEXT* ec);
 TEST*              WINAPI Expert_InitTest(EXECUTION_CONTEXT* ec, BOOL isTesting);
 
 uint               WINAPI FindModuleInLimbo(ModuleType type, const char* name, UninitializeReason uninitReason, BOOL testing, HWND hChart);
+void               WINAPI Limbo_Add(uint pid, ModuleType type, const char* name, HWND hChart);
+void               WINAPI Limbo_Remove(uint pid);
 HWND               WINAPI FindWindowHandle(HWND hChart, const EXECUTION_CONTEXT* sec, ModuleType moduleType, const char* symbol, uint timeframe, BOOL isTesting, BOOL isVisualMode);
 UninitializeReason WINAPI FixUninitReason(EXECUTION_CONTEXT* ec, ModuleType moduleType, CoreFunction coreFunction, UninitializeReason uninitReason);
 
 uint               WINAPI GetCurrentThreadIndex();
+void               WINAPI ReleaseCurrentThreadIndex();
+void               WINAPI ExcludeCurrentThread();
 uint               WINAPI GetLastThreadProgram();
 int                WINAPI SetLastThreadProgram(uint pid);
 
@@ -27,9 +33,21 @@ InitializeReason   WINAPI GetInitReason_indicator(EXECUTION_CONTEXT* ec, const E
 InitializeReason   WINAPI GetInitReason_expert   (EXECUTION_CONTEXT* ec,                                                        const char* programName, UninitializeReason uninitReason, const char* symbol, BOOL testing,                                                   int droppedOnPosX, int droppedOnPosY);
 InitializeReason   WINAPI GetInitReason_script   (EXECUTION_CONTEXT* ec,                                                        const char* programName,                                                                                                                      int droppedOnPosX, int droppedOnPosY);
 
+LogFilter*         WINAPI Program_GetLogFilter  (uint pid);
+TRIGGER_BOOK*      WINAPI Program_GetTriggerBook(uint pid);
+void               WINAPI Program_SetTriggerBook(uint pid, TRIGGER_BOOK* book);
+BOOL               WINAPI Program_IsFinished    (const EXECUTION_CONTEXT* master);
 BOOL               WINAPI Program_IsOptimization(const EXECUTION_CONTEXT* ec, BOOL isOptimization);
 BOOL               WINAPI Program_IsPartialTest (uint pid, const char* programName);
 BOOL               WINAPI Program_IsTesting     (const EXECUTION_CONTEXT* ec, BOOL isTesting);
 BOOL               WINAPI Program_IsVisualMode  (const EXECUTION_CONTEXT* ec, BOOL isVisualMode);
+BOOL               WINAPI Program_IsRetired     (uint pid);
+BOOL               WINAPI Program_Retire        (uint pid);
+uint               WINAPI Program_Reclaim();
+uint               WINAPI Program_CountLive();
+void               WINAPI Program_SetLogger     (EXECUTION_CONTEXT* master, LogFile* logger);
+int                WINAPI Program_StoreCache    (const EXECUTION_CONTEXT* ec, const char* key, const double values[], int size);
+int                WINAPI Program_LoadCache     (const EXECUTION_CONTEXT* ec, const char* key, double values[], int size);
 
 uint               WINAPI PushProgram(ContextChain* chain);
+BOOL               WINAPI SyncLogConfig(const EXECUTION_CONTEXT* ec, ContextChain &chain);
@@ -1,6 +1,8 @@
 #pragma once
 #include "expander.h"
 
+#include <istream>
+
 
 struct REPARSE_DATA_BUFFER {
    ULONG  ReparseTag;
@@ -37,6 +39,7 @@ struct REPARSE_DATA_BUFFER {
 
 int         WINAPI CreateDirectoryA(const char* path, DWORD flags = NULL);
 int         WINAPI CreateDirectoryA(const string &path, DWORD flags = NULL);
+int64       WINAPI FindInStream(std::istream &input, const char* pattern, uint size);
 const char* WINAPI GetFinalPathNameA(const char* name);
 const char* WINAPI GetReparsePointTargetA(const char* name);
 BOOL        WINAPI IsDirectoryA(const char* name);
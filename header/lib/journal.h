@@ -0,0 +1,48 @@
+#pragma once
+#include "expander.h"
+#include "struct/rsf/ExecutionContext.h"
+
+
+#define JOURNAL_SIZE                4096              // number of records in the ring buffer (a power of 2)
+#define JOURNAL_FILE_VERSION           1              // version of the journal file format
+
+// journal events
+#define JOURNAL_SYNCMAINCONTEXT_INIT   1              // SyncMainContext_init() entered
+#define JOURNAL_SYNCMAINCONTEXT_INITED 2              // SyncMainContext_init() left successfully (program resolved)
+#define JOURNAL_SYNCMAINCONTEXT_DEINIT 3              // SyncMainContext_deinit() entered
+#define JOURNAL_SYNCLIBCONTEXT_INIT    4              // SyncLibContext_init() entered
+#define JOURNAL_SYNCLIBCONTEXT_INITED  5              // SyncLibContext_init() left successfully (program resolved)
+#define JOURNAL_SYNCLIBCONTEXT_DEINIT  6              // SyncLibContext_deinit() entered
+#define JOURNAL_LEAVECONTEXT           7              // LeaveContext() entered
+
+
+// a single journal record (64 bytes)
+struct JOURNAL_RECORD {
+   volatile LONG      sequence;                       // sequence number + 1 (0: the record is being written)
+   uint               event;                          // journal event id
+   uint64             time;                           // nanoseconds since the journal was initialized
+   DWORD              threadId;                       // thread executing the event
+   uint               pid;                            // program id (0 if not yet resolved)
+   ModuleType         moduleType;
+   CoreFunction       coreFunction;                   // core function of the module
+   InitializeReason   initReason;                     // init reason of the program
+   UninitializeReason uninitReason;                   // uninit reason as passed by the terminal
+   char               moduleName[24];                 // module name (truncated)
+};
+
+
+// header of a saved journal file, followed by the records in chronological order
+struct JOURNAL_FILE_HEADER {
+   char     magic[8];                                 // "RSFJRNL"
+   uint     version;                                  // JOURNAL_FILE_VERSION
+   uint     recordSize;                               // sizeof(JOURNAL_RECORD)
+   uint     records;                                  // number of records in the file
+   FILETIME startTime;                                // system time (UTC) at record time 0
+};
+
+
+void WINAPI InitJournal();
+void WINAPI Journal_Record(uint event, const EXECUTION_CONTEXT* ec, const char* moduleName = NULL, UninitializeReason uninitReason = UR_UNDEFINED);
+
+int  WINAPI Journal_Save  (const char* filename);
+int  WINAPI Journal_Decode(const char* journalFile, const char* outputFile);
@@ -18,7 +18,7 @@ class Locker {
     * @param  Lock &lock - lock implementation
     */
    public: Locker(Lock &lock) : m_lock(lock) {
-      debug("locking...");
+      debugIn(DIAG_LOCK, "locking...");
       m_lock.lock();
    }
 
@@ -26,7 +26,7 @@ class Locker {
     * Destructor
     */
    public: virtual ~Locker() {
-      debug("unlocking...");
+      debugIn(DIAG_LOCK, "unlocking...");
       m_lock.unlock();
    }
 };
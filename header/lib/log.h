@@ -3,5 +3,17 @@
 #include "struct/rsf/ExecutionContext.h"
 
 
-BOOL WINAPI AppendLogMessageA(EXECUTION_CONTEXT* ec, datetime time, const char* message, int error, int level);
-BOOL WINAPI SetLogfileA      (EXECUTION_CONTEXT* ec, const char* filename);
+BOOL WINAPI AppendLogMessageA      (EXECUTION_CONTEXT* ec, datetime time, const char* message, int error, int level);
+BOOL WINAPI AppendLogEntry         (EXECUTION_CONTEXT* ec, EXECUTION_CONTEXT* master, BOOL useLogger, datetime time, const char* message, int error, int level);
+void WINAPI AppendLogSummary       (EXECUTION_CONTEXT* ec, EXECUTION_CONTEXT* master, BOOL useLogger, datetime time, uint repeated, int repeatedLevel, uint dropped, int droppedLevel);
+BOOL WINAPI FlushLogFilter         (EXECUTION_CONTEXT* ec);
+BOOL WINAPI SetLogfileA            (EXECUTION_CONTEXT* ec, const char* filename);
+BOOL WINAPI SetLogfileRotation     (int maxSize, BOOL daily);
+BOOL WINAPI SetLogRepeatSuppression(int interval);
+BOOL WINAPI SetLogRateLimit        (int level, int rate, int burst);
+
+LogFile* WINAPI Logfile_Acquire(const char* filename, DWORD format);
+LogFile* WINAPI Logfile_Share  (LogFile* logger);
+void     WINAPI Logfile_Release(LogFile* logger);
+BOOL     WINAPI Logfile_Open   (EXECUTION_CONTEXT* master);
+void     WINAPI Logfile_Close  (LogFile* logger);
@@ -0,0 +1,605 @@
+#pragma once
+#include "expander.h"
+#include "lib/compression.h"
+#include "lib/file.h"
+
+#include <algorithm>
+#include <fstream>
+#include <process.h>
+#include <vector>
+#include <winioctl.h>
+
+
+#define LOGFILE_ROTATION_SIZE  (20*1024*1024)         // default max. size of a logfile segment in bytes
+#define LOGFILE_PREALLOCATION   (4*1024*1024)         // max. preallocation step of a logfile segment in bytes
+
+
+extern uint g_logfileRotationSize;                    // max. segment size (0: no size-based rotation)
+extern BOOL g_logfileRotationDaily;                   // whether to start a new segment at the begin of a calendar day
+
+struct BINLOG_DICTIONARY;                             // defined by the binary log
+
+
+/**
+ * A program logfile. The file under the configured name is the active segment. It's rotated by size and by calendar day:
+ * the active segment is renamed to "<name>.<yyyy-mm-dd>.<n><ext>" and compressed in the background, and a new active
+ * segment is started. Disk space of the active segment is preallocated in steps, so appends don't extend the file in small
+ * increments. Writes must go through append(), they are serialized by the log writer.
+ *
+ * The instance lock serializes the open state: the log writer holds it while appending, flushing and rotating, other threads
+ * hold it while opening or closing the logfile. So a thread never sees the closed logfile of a rotation in progress. A
+ * thread holding the lock must not queue log entries (the log writer may wait for the lock).
+ *
+ * In compressed mode data is collected in blocks, each block is compressed independently and written on flush(). After a
+ * crash all flushed blocks remain readable, a torn last block is skipped by Lz_DecompressFile().
+ */
+class LogFile : public std::ofstream {
+
+   /** The configured filename (name of the active segment) */
+   protected: string m_filename;
+
+   /** Whether the directory of the logfile is known to exist */
+   protected: BOOL m_directoryChecked;
+
+   /** A handle to the active segment holding the preallocation */
+   protected: HANDLE m_hFile;
+
+   /** The size of the active segment on disk in bytes */
+   protected: uint64 m_size;
+
+   /** The uncompressed size of the data appended to the active segment in bytes */
+   protected: uint64 m_content;
+
+   /** The preallocated size of the active segment in bytes */
+   protected: uint64 m_allocated;
+
+   /** The calendar day the active segment was started (yyyymmdd) */
+   protected: uint m_day;
+
+   /** Data repeated at the start of every segment (e.g. the header and dictionary of a binary log) */
+   protected: string m_preamble;
+
+   /** The number of programs using the instance (guarded by the logfile registry) */
+   protected: uint m_references;
+
+   /** The log format of all programs using the instance: INIT_BINARY_LOG | INIT_COMPRESSED_LOG (set by the registry) */
+   protected: DWORD m_format;
+
+   /** Whether the logfile is written in compressed blocks */
+   protected: BOOL m_compressed;
+
+   /** The pending uncompressed block (compressed mode only) */
+   protected: char* m_block;
+
+   /** The size of the pending block in bytes */
+   protected: uint m_blockSize;
+
+   /** Output buffer of the block compressor */
+   protected: char* m_buffer;
+
+   /** Whether the logfile must be re-opened because a new segment couldn't be opened on rotation */
+   protected: BOOL m_reopen;
+
+   /** Tick count of the last attempt to re-open the logfile */
+   protected: DWORD m_reopened;
+
+   /** The string dictionary of a binary logfile (managed by the binary log, guarded by g_binaryLogMutex) */
+   protected: BINLOG_DICTIONARY* m_dictionary;
+
+   /** The instance lock */
+   protected: CRITICAL_SECTION m_lock;
+
+
+   /**
+    * Constructor
+    */
+   public: LogFile() : m_directoryChecked(FALSE), m_hFile(INVALID_HANDLE_VALUE), m_size(0), m_content(0), m_allocated(0), m_day(0), m_references(0), m_format(0), m_compressed(FALSE), m_block(NULL), m_blockSize(0), m_buffer(NULL), m_reopen(FALSE), m_reopened(0), m_dictionary(NULL) {
+      InitializeCriticalSection(&m_lock);
+   }
+
+
+   /**
+    * Destructor
+    */
+   public: ~LogFile() {
+      close();
+      free(m_block);
+      free(m_buffer);
+      DeleteCriticalSection(&m_lock);
+   }
+
+
+   /**
+    * Acquire the instance lock. The lock is re-entrant.
+    */
+   public: void lock() {
+      EnterCriticalSection(&m_lock);
+   }
+
+
+   /**
+    * Release the instance lock.
+    */
+   public: void unlock() {
+      LeaveCriticalSection(&m_lock);
+   }
+
+
+   /**
+    * Return the configured filename.
+    *
+    * @return char*
+    */
+   public: const char* filename() const {
+      return(m_filename.c_str());
+   }
+
+
+   /**
+    * Return the number of programs using the instance.
+    *
+    * @return uint
+    */
+   public: uint references() const {
+      return(m_references);
+   }
+
+
+   /**
+    * Add a program to the users of the instance. Must be called by the logfile registry only.
+    *
+    * @return uint - the new number of users
+    */
+   public: uint addReference() {
+      return(++m_references);
+   }
+
+
+   /**
+    * Remove a program from the users of the instance. Must be called by the logfile registry only.
+    *
+    * @return uint - the remaining number of users
+    */
+   public: uint releaseReference() {
+      return(m_references ? --m_references : 0);
+   }
+
+
+   /**
+    * Return the log format of the programs using the instance.
+    *
+    * @return DWORD - INIT_BINARY_LOG | INIT_COMPRESSED_LOG
+    */
+   public: DWORD format() const {
+      return(m_format);
+   }
+
+
+   /**
+    * Set the log format of the programs using the instance. Must be called by the logfile registry only.
+    *
+    * @param  DWORD format - INIT_BINARY_LOG | INIT_COMPRESSED_LOG
+    */
+   public: void setFormat(DWORD format) {
+      m_format = format & (INIT_BINARY_LOG|INIT_COMPRESSED_LOG);
+   }
+
+
+   /**
+    * Return the string dictionary of a binary logfile. Must be called by the binary log only.
+    *
+    * @return BINLOG_DICTIONARY* - dictionary or NULL if the logfile was not opened as a binary logfile
+    */
+   public: BINLOG_DICTIONARY* dictionary() const {
+      return(m_dictionary);
+   }
+
+
+   /**
+    * Set the string dictionary of a binary logfile. Must be called by the binary log only.
+    *
+    * @param  BINLOG_DICTIONARY* dictionary
+    */
+   public: void setDictionary(BINLOG_DICTIONARY* dictionary) {
+      m_dictionary = dictionary;
+   }
+
+
+   /**
+    * Return whether the logfile is written in compressed blocks.
+    *
+    * @return BOOL
+    */
+   public: BOOL compressed() const {
+      return(m_compressed);
+   }
+
+
+   /**
+    * Set the compression mode. Must be called before the logfile is opened, the mode of an open logfile is not changed. An
+    * existing file in a different format is not continued, see open().
+    *
+    * @param  BOOL compressed
+    */
+   public: void setCompressed(BOOL compressed) {
+      if (!is_open()) m_compressed = (compressed != 0);
+   }
+
+
+   /**
+    * Open the logfile for appending. The directory is checked and created only on first use of a filename. An existing file
+    * written in a different format (text, binary, compressed) is renamed like a rotated segment and a new file is started.
+    *
+    * @param  char* filename - full filename
+    *
+    * @return BOOL - success status
+    */
+   public: BOOL open(const char* filename) {
+      if (is_open()) close();
+      if (m_compressed && !m_block) {
+         m_block  = (char*)malloc(LZ_MAX_BLOCK_SIZE);
+         m_buffer = (char*)malloc(LZ_BOUND(LZ_MAX_BLOCK_SIZE));
+         if (!m_block || !m_buffer) return(error(ERR_OUT_OF_MEMORY, "malloc(%d) failed", LZ_BOUND(LZ_MAX_BLOCK_SIZE)));
+      }
+
+      if (m_filename != filename) {
+         m_filename = filename;
+         m_directoryChecked = FALSE;
+      }
+      if (!m_directoryChecked) {
+         if (!IsFileA(filename)) {
+            char drive[MAX_DRIVE], dir[MAX_DIR];                           // extract the directory part of the filename
+            _splitpath(filename, drive, dir, NULL, NULL);
+            if (CreateDirectoryA(string(drive).append(dir), MKDIR_PARENT))  // make sure the directory exists
+               return(FALSE);
+         }
+         m_directoryChecked = TRUE;
+      }
+      if (!moveForeignFile(filename)) return(FALSE);
+
+      std::ofstream::open(filename, std::ios::binary|std::ios::app);
+      if (!is_open()) return(error(ERR_WIN32_ERROR+GetLastError(), "opening of \"%s\" failed (%s)", filename, strerror(errno)));
+
+      SYSTEMTIME st; GetLocalTime(&st);
+      m_size = 0;
+      m_day  = st.wYear*10000 + st.wMonth*100 + st.wDay;
+
+      WIN32_FILE_ATTRIBUTE_DATA data;                                   // an existing segment keeps its start day
+      if (GetFileAttributesExA(filename, GetFileExInfoStandard, &data) && (data.nFileSizeLow || data.nFileSizeHigh)) {
+         FILETIME ft;
+         FileTimeToLocalFileTime(&data.ftLastWriteTime, &ft);
+         FileTimeToSystemTime(&ft, &st);
+         m_size = (uint64)data.nFileSizeHigh << 32 | data.nFileSizeLow;
+         m_day  = st.wYear*10000 + st.wMonth*100 + st.wDay;
+      }
+      m_content   = m_size;
+      m_blockSize = 0;
+      m_reopen    = FALSE;
+
+      m_hFile = CreateFileA(filename, GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+      m_allocated = m_size;
+      preallocate();
+      return(TRUE);
+   }
+
+
+   /**
+    * Close the logfile. A pending block is written, the unused preallocation is released by the file system.
+    */
+   public: void close() {
+      if (is_open()) writeBlock();
+      if (m_hFile != INVALID_HANDLE_VALUE) {
+         CloseHandle(m_hFile);
+         m_hFile = INVALID_HANDLE_VALUE;
+      }
+      if (is_open()) std::ofstream::close();
+   }
+
+
+   /**
+    * Append data to the active segment. If the segment is due for rotation a new segment is started first. If a previous
+    * rotation couldn't open the new segment it's retried once per second.
+    *
+    * @param  char* data
+    * @param  uint  size - data size in bytes
+    *
+    * @return BOOL - whether the data was appended (FALSE if the logfile is closed)
+    */
+   public: BOOL append(const char* data, uint size) {
+      if (!is_open()) {
+         if (!m_reopen || GetTickCount()-m_reopened < 1000) return(FALSE);
+         m_reopened = GetTickCount();
+         if (!open(m_filename.c_str())) {
+            m_reopen = TRUE;
+            return(FALSE);
+         }
+         if (!m_size) put(m_preamble.data(), m_preamble.size());     // a new segment
+      }
+      BOOL isEmpty = (m_content <= m_preamble.size());
+
+      if (g_logfileRotationSize && m_size+m_blockSize+size > g_logfileRotationSize && !isEmpty) {
+         rotate();
+      }
+      else if (g_logfileRotationDaily) {
+         SYSTEMTIME st; GetLocalTime(&st);
+         uint today = st.wYear*10000 + st.wMonth*100 + st.wDay;
+         if (today != m_day) {
+            if (isEmpty) m_day = today;
+            else         rotate();
+         }
+      }
+      if (!is_open()) return(FALSE);                                    // the new segment couldn't be opened
+      put(data, size);
+      return(TRUE);
+   }
+
+
+   /**
+    * Flush the logfile. In compressed mode the pending block is compressed and written, so flushed data always ends on a
+    * block boundary.
+    *
+    * @return LogFile& - the instance
+    */
+   public: LogFile& flush() {
+      writeBlock();
+      std::ofstream::flush();
+      return(*this);
+   }
+
+
+   /**
+    * Add data already appended to the active segment to the preamble of following segments.
+    *
+    * @param  char* data
+    * @param  uint  size - data size in bytes
+    */
+   public: void addPreamble(const char* data, uint size) {
+      m_preamble.append(data, size);
+   }
+
+
+   /**
+    * Reset the preamble of following segments.
+    */
+   public: void clearPreamble() {
+      m_preamble.clear();
+   }
+
+
+   /**
+    * Close the active segment, rename it to its segment name, queue it for compression and start a new segment. If the
+    * segment can't be renamed it's continued. If the new segment can't be opened the logfile stays closed and opening is
+    * retried by append(). Called by the log writer holding the instance lock.
+    *
+    * @return BOOL - success status
+    */
+   protected: BOOL rotate() {
+      flush();
+      close();
+
+      char segment[MAX_PATH];
+      segmentName(m_day, segment);
+
+      BOOL renamed = MoveFileA(m_filename.c_str(), segment);
+      if (!renamed)           error(ERR_WIN32_ERROR+GetLastError(), "cannot rename logfile \"%s\" to \"%s\"", m_filename.c_str(), segment);
+      else if (!m_compressed) queueCompression(segment);
+
+      if (!open(m_filename.c_str())) {
+         m_reopen   = TRUE;
+         m_reopened = GetTickCount();
+         return(FALSE);
+      }
+      if (renamed) {
+         put(m_preamble.data(), m_preamble.size());
+      }
+      else {
+         SYSTEMTIME st; GetLocalTime(&st);                              // continue the segment
+         m_size    = 0;
+         m_content = 0;
+         m_day     = st.wYear*10000 + st.wMonth*100 + st.wDay;
+      }
+      return(TRUE);
+   }
+
+
+   /**
+    * Resolve the next unused segment name of the logfile for a calendar day.
+    *
+    * @param  uint day               - calendar day (yyyymmdd)
+    * @param  char segment[MAX_PATH] - buffer receiving the segment name
+    */
+   protected: void segmentName(uint day, char* segment) const {
+      char drive[MAX_DRIVE], dir[MAX_DIR], fname[MAX_FNAME], ext[MAX_EXT];
+      _splitpath(m_filename.c_str(), drive, dir, fname, ext);
+      for (uint i=1; ; ++i) {
+         sprintf_s(segment, MAX_PATH, "%s%s%s.%04d-%02d-%02d.%d%s", drive, dir, fname, day/10000, day/100%100, day%100, i, ext);
+         if (!IsFileA(segment)) break;
+      }
+   }
+
+
+   /**
+    * Compress a closed segment by the file system in the background. The compression thread holds a reference to the DLL,
+    * so the DLL isn't unloaded while the thread is running.
+    *
+    * @param  char* segment - segment name
+    */
+   protected: void queueCompression(const char* segment) {
+      HMODULE hModule;
+      if (!GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCTSTR)compressSegment, &hModule)) {
+         warn(ERR_WIN32_ERROR+GetLastError(), "cannot compress \"%s\" (GetModuleHandleEx() failed)", segment);
+         return;
+      }
+      char* filename = strdup(segment);
+      HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, compressSegment, filename, 0, NULL);
+      if (hThread) CloseHandle(hThread);
+      else {
+         warn(ERR_WIN32_ERROR+GetLastError(), "cannot compress \"%s\" (_beginthreadex() failed)", segment);
+         free(filename);
+         FreeLibrary(hModule);
+      }
+   }
+
+
+   /**
+    * Return the format of an existing logfile as identified by its leading bytes. A compressed logfile starts with a block
+    * magic, a binary logfile starts with a session header (in compressed mode inside the first block).
+    *
+    * @param  char* filename
+    *
+    * @return DWORD - INIT_BINARY_LOG | INIT_COMPRESSED_LOG or NULL (0) for a text logfile; EMPTY (-1) if the file doesn't
+    *                 exist or is empty
+    */
+   protected: static DWORD fileFormat(const char* filename) {
+      std::ifstream input(filename, std::ios::binary);
+      LZ_BLOCK_HEADER header;
+      input.read((char*)&header, sizeof(header));
+      uint size = (uint)input.gcount();
+      if (!size) return(EMPTY);
+
+      std::vector<char> data((char*)&header, (char*)&header + size);
+      DWORD format = NULL;
+
+      if (size==sizeof(header) && !memcmp(header.magic, LZ_BLOCK_MAGIC, sizeof(header.magic))) {
+         format = INIT_COMPRESSED_LOG;
+         data.clear();
+         if (header.size <= header.rawSize && header.rawSize <= LZ_MAX_BLOCK_SIZE) {
+            std::vector<char> block(header.size+1);
+            if (input.read(&block[0], header.size)) {
+               if (header.size == header.rawSize) data.assign(block.begin(), block.end()-1);       // a stored block
+               else {
+                  data.resize(header.rawSize);
+                  if (Lz_Decompress(&block[0], header.size, &data[0], header.rawSize) != (int)header.rawSize) data.clear();
+               }
+            }
+         }
+      }
+
+      // the session header of a binary logfile: uint size, uchar type=BINLOG_HEADER (1), char magic[8]="RSFBLOG"
+      if (data.size() >= 13 && data[4]==1 && !memcmp(&data[5], "RSFBLOG", 8)) format |= INIT_BINARY_LOG;
+      return(format);
+   }
+
+
+   /**
+    * Move an existing logfile written in a different format out of the way, so it's not continued in the wrong format (e.g.
+    * a binary session appended to a text logfile can't be decoded). The file is renamed like a rotated segment of the day
+    * it was last written.
+    *
+    * @param  char* filename
+    *
+    * @return BOOL - success status
+    */
+   protected: BOOL moveForeignFile(const char* filename) {
+      DWORD format = fileFormat(filename);
+      if (format==EMPTY || format==((m_format & INIT_BINARY_LOG) | (m_compressed ? INIT_COMPRESSED_LOG : 0))) return(TRUE);
+
+      WIN32_FILE_ATTRIBUTE_DATA data;
+      SYSTEMTIME st; GetLocalTime(&st);
+      if (GetFileAttributesExA(filename, GetFileExInfoStandard, &data)) {
+         FILETIME ft;
+         FileTimeToLocalFileTime(&data.ftLastWriteTime, &ft);
+         FileTimeToSystemTime(&ft, &st);
+      }
+      char segment[MAX_PATH];
+      segmentName(st.wYear*10000 + st.wMonth*100 + st.wDay, segment);
+
+      if (!MoveFileA(filename, segment)) return(error(ERR_WIN32_ERROR+GetLastError(), "cannot rename logfile \"%s\" in a different format to \"%s\"", filename, segment));
+      if (!(format & INIT_COMPRESSED_LOG)) queueCompression(segment);
+      return(TRUE);
+   }
+
+
+   /**
+    * Write data to the active segment. In compressed mode the data is collected in the pending block.
+    *
+    * @param  char* data
+    * @param  uint  size - data size in bytes
+    */
+   protected: void put(const char* data, uint size) {
+      m_content += size;
+      if (!m_compressed) {
+         write(data, size);
+         m_size += size;
+      }
+      else while (size) {
+         uint n = std::min(size, (uint)LZ_MAX_BLOCK_SIZE - m_blockSize);
+         memcpy(m_block + m_blockSize, data, n);
+         m_blockSize += n;
+         data        += n;
+         size        -= n;
+         if (m_blockSize == LZ_MAX_BLOCK_SIZE) writeBlock();
+      }
+      if (m_size > m_allocated) preallocate();
+   }
+
+
+   /**
+    * Compress and write the pending block (compressed mode only).
+    */
+   protected: void writeBlock() {
+      if (m_blockSize) {
+         m_size += Lz_WriteBlock(*this, m_block, m_blockSize, m_buffer);
+         m_blockSize = 0;
+         if (m_size > m_allocated) preallocate();
+      }
+   }
+
+
+   /**
+    * Extend the preallocation of the active segment by the next step. A failing preallocation is not an error. The
+    * allocation is never set below the current end of file, the file system would truncate the file to it.
+    */
+   protected: void preallocate() {
+      typedef BOOL (WINAPI *SetFileInformationByHandleFn)(HANDLE hFile, int infoClass, void* info, DWORD size);
+      static SetFileInformationByHandleFn setFileInformation = (SetFileInformationByHandleFn)GetProcAddress(GetModuleHandleA("kernel32.dll"), "SetFileInformationByHandle");
+      if (!setFileInformation || m_hFile==INVALID_HANDLE_VALUE) return;             // not supported before Windows Vista
+
+      LARGE_INTEGER fileSize;
+      if (!GetFileSizeEx(m_hFile, &fileSize)) return;                               // when in doubt don't preallocate
+
+      uint64 step = LOGFILE_PREALLOCATION;
+      if (g_logfileRotationSize) step = std::min(step, (uint64)g_logfileRotationSize);
+      uint64 size = std::max(m_size, (uint64)fileSize.QuadPart);                   // m_size may be behind the end of file
+      m_allocated = (size/step + 1) * step;
+
+      LARGE_INTEGER allocationSize;
+      allocationSize.QuadPart = m_allocated;
+      setFileInformation(m_hFile, 5, &allocationSize, sizeof(allocationSize));     // 5: FileAllocationInfo
+   }
+
+
+   /**
+    * Entry point of a thread compressing a closed segment using file system compression. The thread releases the DLL
+    * reference taken by queueCompression() on exit. A dedicated thread is used as a thread pool callback can't release the
+    * DLL it's running in.
+    *
+    * @param  void* param - filename of the segment (released by the thread)
+    *
+    * @return uint - thread exit code
+    */
+   protected: static uint __stdcall compressSegment(void* param) {
+      char* filename = (char*)param;
+
+      HANDLE hFile = CreateFileA(filename, GENERIC_READ|GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+      if (hFile == INVALID_HANDLE_VALUE) {
+         warn(ERR_WIN32_ERROR+GetLastError(), "cannot open logfile segment \"%s\"", filename);
+      }
+      else {
+         USHORT format = COMPRESSION_FORMAT_DEFAULT;
+         DWORD bytes;
+         if (!DeviceIoControl(hFile, FSCTL_SET_COMPRESSION, &format, sizeof(format), NULL, 0, &bytes, NULL)) {
+            DWORD lastError = GetLastError();
+            if (lastError != ERROR_INVALID_FUNCTION)                   // the file system doesn't support compression
+               warn(ERR_WIN32_ERROR+lastError, "cannot compress logfile segment \"%s\"", filename);
+         }
+         CloseHandle(hFile);
+      }
+      free(filename);
+
+      HMODULE hModule = NULL;
+      GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS|GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCTSTR)compressSegment, &hModule);
+      FreeLibraryAndExitThread(hModule, 0);                             // release the reference taken by queueCompression()
+      return(0);
+   }
+};
@@ -0,0 +1,188 @@
+#pragma once
+#include "expander.h"
+
+#include <algorithm>
+
+
+#define LOGFILTER_REPEAT_INTERVAL      0              // default max. time in msec repeats of a message are collapsed (opt-in)
+#define LOGFILTER_LEVELS               6              // number of loglevels with a separate rate limit (LOG_DEBUG...LOG_FATAL)
+
+
+struct LOG_RATE_LIMIT {                               // token bucket configuration of a loglevel
+   uint rate;                                         // messages per second (0: unlimited)
+   uint burst;                                        // max. number of messages in a burst
+};
+
+extern uint           g_logRepeatInterval;                        // max. time in msec repeats are collapsed (0: no suppression)
+extern LOG_RATE_LIMIT g_logRateLimits[LOGFILTER_LEVELS];          // rate limits by loglevel index
+
+
+/**
+ * The log filter of a program. Checks a message before it's formatted: identical messages (same loglevel, error and text)
+ * are collapsed into a "repeated N times" summary, and messages exceeding the token bucket rate limit of their loglevel are
+ * dropped and counted. Time is passed in by the caller (online the tick count, in tester the modeled time), so in tester
+ * intervals and rates refer to modeled time. A filter is used only by the thread executing the program, it's not
+ * synchronized.
+ */
+class LogFilter {
+
+   /** Hash of the last passed message */
+   protected: uint64 m_hash;
+
+   /** Loglevel of the last passed message */
+   protected: int m_level;
+
+   /** Time in msec the last message was passed */
+   protected: DWORD m_passed;
+
+   /** The number of suppressed repeats of the last passed message */
+   protected: uint m_repeated;
+
+   /** The number of repeats to report before the current message */
+   protected: uint m_summary;
+
+   /** Loglevel of the repeats to report */
+   protected: int m_summaryLevel;
+
+   /** Tokens available per loglevel in 1/1000 messages */
+   protected: uint m_tokens[LOGFILTER_LEVELS];
+
+   /** Time in msec of the last token refill per loglevel */
+   protected: DWORD m_refilled[LOGFILTER_LEVELS];
+
+   /** The number of messages dropped by the rate limit per loglevel */
+   protected: uint m_dropped[LOGFILTER_LEVELS];
+
+
+   /**
+    * Constructor
+    */
+   public: LogFilter() : m_hash(0), m_level(0), m_passed(0), m_repeated(0), m_summary(0), m_summaryLevel(0) {
+      for (int i=0; i < LOGFILTER_LEVELS; ++i) {
+         m_tokens[i] = m_refilled[i] = m_dropped[i] = 0;
+      }
+   }
+
+
+   /**
+    * Check whether a message is to be logged. Must be called before the message is formatted. If the function returns TRUE
+    * pending summaries must be fetched with repeated() and dropped() and logged before the message.
+    *
+    * @param  int   level   - loglevel of the message
+    * @param  int   error   - error linked to the message (if any)
+    * @param  char* message - message text
+    * @param  DWORD now     - current time in msec (online: tick count, tester: modeled time)
+    *
+    * @return BOOL - whether the message passes the filter
+    */
+   public: BOOL pass(int level, int error, const char* message, DWORD now) {
+      uint64 hash = 14695981039346656037ULL;                         // FNV-1a over loglevel, error and text
+      hash = (hash ^ (uint)level) * 1099511628211ULL;
+      hash = (hash ^ (uint)error) * 1099511628211ULL;
+      for (const char* c=message; *c; ++c) {
+         hash = (hash ^ (uchar)*c) * 1099511628211ULL;
+      }
+
+      if (g_logRepeatInterval && hash==m_hash && now-m_passed < g_logRepeatInterval) {
+         m_repeated++;                                               // a repeat of the last message
+         return(FALSE);
+      }
+
+      int i = levelIndex(level);
+      const LOG_RATE_LIMIT &limit = g_logRateLimits[i];
+      if (limit.rate) {
+         uint maxTokens = std::max(limit.burst, (uint)1) * 1000;
+         if (!m_refilled[i]) {
+            m_tokens[i] = maxTokens;                                 // start with a full bucket
+         }
+         else {
+            uint64 tokens = m_tokens[i] + (uint64)(now - m_refilled[i]) * limit.rate;
+            m_tokens[i] = (uint)std::min(tokens, (uint64)maxTokens);
+         }
+         m_refilled[i] = now ? now : 1;
+         if (m_tokens[i] < 1000) {
+            m_dropped[i]++;
+            return(FALSE);
+         }
+         m_tokens[i] -= 1000;
+      }
+
+      m_summary      = m_repeated;                                   // repeats of the previous message are reported first
+      m_summaryLevel = m_level;
+      m_repeated     = 0;
+      m_hash         = hash;
+      m_level        = level;
+      m_passed       = now;
+      return(TRUE);
+   }
+
+
+   /**
+    * Return and reset the number of suppressed repeats of the message passed before the current one.
+    *
+    * @param  int &level - variable receiving the loglevel of the repeated message
+    *
+    * @return uint - number of repeats
+    */
+   public: uint repeated(int &level) {
+      uint repeated = m_summary;
+      level = m_summaryLevel;
+      m_summary = 0;
+      return(repeated);
+   }
+
+
+   /**
+    * Return and reset the number of messages of a loglevel dropped by the rate limit.
+    *
+    * @param  int level
+    *
+    * @return uint - number of dropped messages
+    */
+   public: uint dropped(int level) {
+      int i = levelIndex(level);
+      uint dropped = m_dropped[i];
+      m_dropped[i] = 0;
+      return(dropped);
+   }
+
+
+   /**
+    * Return and reset all pending counts, e.g. before the program is finished: the suppressed repeats of the last passed
+    * message and the messages dropped by the rate limit since the last passed message.
+    *
+    * @param  int  &level    - variable receiving the loglevel of the repeated message
+    * @param  uint  dropped[] - array of LOGFILTER_LEVELS elements receiving the number of dropped messages per loglevel index
+    *
+    * @return uint - number of repeats
+    */
+   public: uint flush(int &level, uint dropped[]) {
+      uint repeated = m_summary + m_repeated;                        // m_summary is normally reported already
+      level = m_summary ? m_summaryLevel : m_level;
+      m_summary = m_repeated = 0;
+      m_hash = 0;                                                    // a following repeat is logged again
+
+      for (int i=0; i < LOGFILTER_LEVELS; ++i) {
+         dropped[i] = m_dropped[i];
+         m_dropped[i] = 0;
+      }
+      return(repeated);
+   }
+
+
+   /**
+    * Return the rate limit index of a loglevel.
+    *
+    * @param  int level
+    *
+    * @return int - index between 0 (LOG_DEBUG) and LOGFILTER_LEVELS-1 (LOG_FATAL)
+    */
+   public: static int levelIndex(int level) {
+      int i = 0;
+      while (level > LOG_DEBUG && i < LOGFILTER_LEVELS-1) {
+         level >>= 1;
+         i++;
+      }
+      return(i);
+   }
+};
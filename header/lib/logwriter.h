@@ -0,0 +1,29 @@
+#pragma once
+#include "expander.h"
+#include "lib/log/LogFile.h"
+
+
+#define LOG_QUEUE_SIZE           4096                 // number of records in the log queue (a power of 2)
+#define LOG_RECORD_TEXT           480                 // inline text capacity of a record (longer entries are allocated)
+#define LOG_FLUSH_INTERVAL        100                 // max. time in msec a queued entry waits before it's written and flushed
+
+
+// a queued log entry
+struct LOG_RECORD {
+   volatile LONG  sequence;                           // queue position the slot is ready for (written by producers and consumer)
+   LogFile*       logger;                             // target logfile
+   uint           size;                               // entry size in bytes
+   BOOL           preamble;                           // whether the entry is repeated at the start of following segments
+   char*          data;                               // entry text: points to the inline text or to an allocated buffer
+   char           text[LOG_RECORD_TEXT];
+};
+
+
+void WINAPI InitLogWriter();
+void WINAPI ReleaseLogWriter(BOOL isTerminating);
+BOOL WINAPI ShutdownLogWriter();
+
+BOOL WINAPI LogWriter_Append(LogFile* logger, const char* data, uint size, BOOL preamble = FALSE);
+uint WINAPI LogWriter_Flush();
+BOOL WINAPI LogWriter_Start();
+void WINAPI LogWriter_StopIdle();
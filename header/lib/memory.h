@@ -10,3 +10,39 @@ uint WINAPI GetStringAddress(const TCHAR* value);
 uint WINAPI GetStringsAddress(const MqlStringA values[]);
 
 BOOL WINAPI MemCompare(const void* a, const void* b, uint size);
+
+char* WINAPI GetScratchBuffer(uint size);
+uint  WINAPI GetHotPathAllocations();
+uint  WINAPI ResetHotPathAllocations();
+void  WINAPI HotPath_CountAllocation();
+void  WINAPI HotPath_Enter();
+void  WINAPI HotPath_Leave();
+
+void  WINAPI InitMemory();
+void  WINAPI ReleaseMemory();
+void  WINAPI ReleaseThreadScratchBuffer();
+
+
+#define SCRATCH_BUFFER_SIZE  4096                     // initial size of a thread's scratch buffer
+
+
+/**
+ * A class marking a scoped code block as an allocation-free hot path. Heap allocations made by the current thread while an
+ * instance exists are counted, see GetHotPathAllocations().
+ */
+class HotPath {
+
+   /**
+    * Constructor
+    */
+   public: HotPath() {
+      HotPath_Enter();
+   }
+
+   /**
+    * Destructor
+    */
+   public: ~HotPath() {
+      HotPath_Leave();
+   }
+};
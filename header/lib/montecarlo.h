@@ -0,0 +1,22 @@
+#pragma once
+#include "expander.h"
+#include "struct/rsf/ExecutionContext.h"
+
+#include <vector>
+
+
+// results of a Monte Carlo analysis (MQL: double[6]), all values in pip
+struct MONTE_CARLO_RESULT {
+   double drawdownLower;                              // lower bound of the confidence interval of the max. drawdown
+   double drawdownMedian;                             // median of the max. drawdown
+   double drawdownUpper;                              // upper bound of the confidence interval of the max. drawdown
+   double equityLower;                                // lower bound of the confidence interval of the final equity
+   double equityMedian;                               // median of the final equity
+   double equityUpper;                                // upper bound of the confidence interval of the final equity
+};
+
+
+BOOL WINAPI MonteCarlo_Run(const std::vector<double> &trades, uint iterations, DWORD flags, double skipRatio, double slippage, double confidence, MONTE_CARLO_RESULT* result);
+
+BOOL WINAPI Test_MonteCarlo          (const EXECUTION_CONTEXT* ec, uint iterations, DWORD flags, double skipRatio, double slippage, double confidence, MONTE_CARLO_RESULT* result);
+BOOL WINAPI Test_MonteCarloFromReport(const char* filename,        uint iterations, DWORD flags, double skipRatio, double slippage, double confidence, MONTE_CARLO_RESULT* result);
@@ -0,0 +1,73 @@
+#pragma once
+#include "expander.h"
+#include "lib/container/SegmentedVector.h"
+
+
+#define LATENCY_PROBES            7                   // number of latency probes: PROBE_SYNCMAINCONTEXT_INIT...PROBE_APPENDLOGMESSAGE
+#define LATENCY_BUCKETS          96                   // log-linear histogram buckets: 4 per power of 2 up to 2^25 microseconds
+
+
+// latency statistics of a single MQL program in a single thread
+struct PROGRAM_PROFILE {
+   uint   calls    [LATENCY_PROBES];                  // number of calls
+   uint64 totalTime[LATENCY_PROBES];                  // sum of all latencies in microseconds
+   uint   maxTime  [LATENCY_PROBES];                  // max. latency in microseconds
+   uint   histogram[LATENCY_PROBES][LATENCY_BUCKETS]; // latency histogram
+};
+
+
+// latency statistics of all MQL programs executed by a single thread (written by the owning thread only, profiles of
+// reclaimed programs are released by Program_Reclaim())
+struct THREAD_PROFILE {
+   DWORD                             threadId;
+   SegmentedVector<PROGRAM_PROFILE*> programs;        // index: program id
+};
+
+
+uint WINAPI Profiler_GetBucket(uint latency);
+uint WINAPI Profiler_GetBucketLimit(int bucket);
+int  WINAPI Profiler_GetHistogram(uint pid, int probe, uint buckets[], int size);
+BOOL WINAPI Profiler_GetStats(uint pid, int probe, double stats[]);
+uint WINAPI Profiler_SetDumpInterval(uint seconds);
+BOOL WINAPI Profiler_Dump();
+void WINAPI Profiler_Record(int probe, uint pid, LONGLONG startCounter);
+void WINAPI Profiler_ReleaseProgram(uint pid);
+LONGLONG WINAPI Profiler_StartCounter();
+
+void WINAPI InitProfiler();
+void WINAPI ReleaseProfiler();
+
+
+/**
+ * A class to measure the latency of a scoped code block (i.e. a scoped probe). The latency is recorded on instance
+ * destruction for the specified program or, if no program is specified, for the program last executed by the thread.
+ */
+class LatencyProbe {
+
+   /** The probe id. */
+   protected: int m_probe;
+
+   /** The program id (if known). */
+   protected: uint m_pid;
+
+   /** The performance counter at instance construction. */
+   protected: LONGLONG m_start;
+
+
+   /**
+    * Constructor
+    *
+    * @param  int  probe          - probe id: PROBE_SYNCMAINCONTEXT_INIT...PROBE_APPENDLOGMESSAGE
+    * @param  uint pid [optional] - program id (default: the program last executed by the thread at instance destruction)
+    */
+   public: LatencyProbe(int probe, uint pid = NULL) : m_probe(probe), m_pid(pid) {
+      m_start = Profiler_StartCounter();
+   }
+
+   /**
+    * Destructor
+    */
+   public: ~LatencyProbe() {
+      Profiler_Record(m_probe, m_pid, m_start);
+   }
+};
@@ -15,6 +15,13 @@ double            WINAPI Test_GetCommission  (const EXECUTION_CONTEXT* ec, doubl
 BOOL              WINAPI Test_onPositionOpen (const EXECUTION_CONTEXT* ec, int ticket, int type, double lots, const char* symbol, double openPrice, datetime openTime, double stopLoss, double takeProfit, double commission, int magicNumber, const char* comment);
 BOOL              WINAPI Test_onPositionClose(const EXECUTION_CONTEXT* ec, int ticket, double closePrice, datetime closeTime, double swap, double profit);
 
+int               WINAPI Test_GetClosedTrades        (const EXECUTION_CONTEXT* ec,                    datetime from, datetime to);
+int               WINAPI Test_GetClosedTradesByMagic (const EXECUTION_CONTEXT* ec, int magicNumber,   datetime from, datetime to);
+int               WINAPI Test_GetClosedTradesBySymbol(const EXECUTION_CONTEXT* ec, const char* symbol, datetime from, datetime to);
+double            WINAPI Test_GetClosedProfit        (const EXECUTION_CONTEXT* ec,                    datetime from, datetime to);
+double            WINAPI Test_GetClosedProfitByMagic (const EXECUTION_CONTEXT* ec, int magicNumber,   datetime from, datetime to);
+double            WINAPI Test_GetClosedProfitBySymbol(const EXECUTION_CONTEXT* ec, const char* symbol, datetime from, datetime to);
+
 BOOL              WINAPI Test_SaveReport(const TEST* test);
 BOOL              WINAPI Test_StartReporting(const EXECUTION_CONTEXT* ec, datetime time, uint bars, int reportId, const char* reportSymbol);
 BOOL              WINAPI Test_StopReporting (const EXECUTION_CONTEXT* ec, datetime time, uint bars);
@@ -0,0 +1,40 @@
+#pragma once
+#include "expander.h"
+#include "struct/rsf/ExecutionContext.h"
+
+#include <map>
+#include <vector>
+
+
+// a single price level registered in a trigger book
+struct TRIGGER {
+   int ticket;                                        // order ticket
+   int event;                                         // TRIGGER_OPEN | TRIGGER_STOPLOSS | TRIGGER_TAKEPROFIT
+};
+
+typedef std::multimap<double, TRIGGER>                                    TriggerLevels;   // price levels sorted by price
+typedef std::vector<std::pair<TriggerLevels*, TriggerLevels::iterator> >  TicketLevels;    // all levels of a ticket (max. 2)
+typedef std::map<int, TicketLevels>                                       TicketIndex;     // levels by ticket
+typedef std::vector<TRIGGER>                                              TriggerList;
+
+
+// price-sorted stop and limit levels of a single MQL program
+struct TRIGGER_BOOK {
+   TriggerLevels bidFalling;                          // triggered by Bid <= level: long stoploss, sell stop
+   TriggerLevels bidRising;                           // triggered by Bid >= level: long takeprofit, sell limit
+   TriggerLevels askFalling;                          // triggered by Ask <= level: short takeprofit, buy limit
+   TriggerLevels askRising;                           // triggered by Ask >= level: short stoploss, buy stop
+   TicketIndex   tickets;                             // registered levels by ticket
+   TriggerList   triggered;                           // triggered levels of the last processed tick
+};
+
+
+TRIGGER_BOOK* WINAPI GetTriggerBook(uint pid, BOOL create = FALSE);
+
+BOOL WINAPI Trigger_SetOrder    (const EXECUTION_CONTEXT* ec, int ticket, int type, double openPrice, double stopLoss, double takeProfit);
+BOOL WINAPI Trigger_RemoveOrder (const EXECUTION_CONTEXT* ec, int ticket);
+int  WINAPI Trigger_GetTriggered(const EXECUTION_CONTEXT* ec, int tickets[], int events[], int size);
+
+BOOL WINAPI Trigger_onTick(uint pid, double bid, double ask, double point);
+void WINAPI ReleaseTriggerBook(uint pid);
+void WINAPI ReleaseTriggerBooks();
@@ -181,6 +181,12 @@
 #define OA_STOP                                 2
 
 
+// trigger book events, see Trigger_GetTriggered()
+#define TRIGGER_OPEN                            1        // entry level of a pending order reached
+#define TRIGGER_STOPLOSS                        2        // stoploss of a position reached
+#define TRIGGER_TAKEPROFIT                      3        // takeprofit of a position reached
+
+
 // trade directions, can be used as flags
 #define TRADE_DIRECTION_LONG                    1
 #define TRADE_DIRECTION_SHORT                   2
@@ -200,6 +206,26 @@
 #define PRICE_ASK                               9        // Ask
 
 
+// profit calculation modes, see struct FXT_HEADER
+#define PROFITCALCMODE_FOREX                    0        // (close-open) * contractSize * lots
+#define PROFITCALCMODE_CFD                      1        // (close-open) * contractSize * lots
+#define PROFITCALCMODE_FUTURES                  2        // (close-open) / tickSize * tickValue * lots
+
+
+// swap calculation types, see struct FXT_HEADER
+#define SWAPTYPE_POINTS                         0        // swap value in points
+#define SWAPTYPE_BASECURRENCY                   1        // swap value in base currency
+#define SWAPTYPE_INTEREST                       2        // swap value as annual interest rate in percent
+#define SWAPTYPE_MARGINCURRENCY                 3        // swap value in margin currency
+
+
+// margin calculation modes, see struct FXT_HEADER
+#define MARGINCALCMODE_FOREX                    0        // contractSize * lots / leverage
+#define MARGINCALCMODE_CFD                      1        // contractSize * lots * price
+#define MARGINCALCMODE_FUTURES                  2        // marginInit * lots
+#define MARGINCALCMODE_CFD_LEVERAGE             3        // contractSize * lots * price / leverage
+
+
 // commission types, see struct FXT_HEADER
 #define COMM_TYPE_MONEY                         0        // base commission in money terms
 #define COMM_TYPE_POINTS                        1        // base commission in points
@@ -216,6 +242,103 @@
 #define MODE_MARKUP                             1        // commission markup in quote currency
 
 
+// Monte Carlo resampling flags, see Test_MonteCarlo()
+#define MC_SHUFFLE                              1        // random permutation of the trade sequence
+#define MC_BOOTSTRAP                            2        // random sampling of trades with replacement
+#define MC_SKIP_TRADES                          4        // randomly skip trades
+#define MC_SLIPPAGE                             8        // randomized slippage on the trade results
+
+
+// DLL latency probes, see Profiler_GetHistogram()
+#define PROBE_SYNCMAINCONTEXT_INIT              0
+#define PROBE_SYNCMAINCONTEXT_START             1
+#define PROBE_SYNCMAINCONTEXT_DEINIT            2
+#define PROBE_SYNCLIBCONTEXT_INIT               3
+#define PROBE_SYNCLIBCONTEXT_DEINIT             4
+#define PROBE_LEAVECONTEXT                      5
+#define PROBE_APPENDLOGMESSAGE                  6
+
+
+// execution context fields, see ec_GetValues()
+#define ECV_VERSION                             1        // version of the field list (fields are only appended)
+#define ECV_PID                                 0
+#define ECV_PREVIOUSPID                         1
+#define ECV_PROGRAMTYPE                         2
+#define ECV_PROGRAMCOREFUNCTION                 3
+#define ECV_PROGRAMINITREASON                   4
+#define ECV_PROGRAMUNINITREASON                 5
+#define ECV_PROGRAMINITFLAGS                    6
+#define ECV_PROGRAMDEINITFLAGS                  7
+#define ECV_MODULETYPE                          8
+#define ECV_MODULECOREFUNCTION                  9
+#define ECV_MODULEUNINITREASON                  10
+#define ECV_MODULEINITFLAGS                     11
+#define ECV_MODULEDEINITFLAGS                   12
+#define ECV_TIMEFRAME                           13
+#define ECV_BARS                                14
+#define ECV_CHANGEDBARS                         15
+#define ECV_UNCHANGEDBARS                       16
+#define ECV_TICKS                               17
+#define ECV_CYCLETICKS                          18
+#define ECV_PREVTICKTIME                        19
+#define ECV_CURRTICKTIME                        20
+#define ECV_BID                                 21
+#define ECV_ASK                                 22
+#define ECV_DIGITS                              23
+#define ECV_PIPDIGITS                           24
+#define ECV_SUBPIPDIGITS                        25
+#define ECV_PIP                                 26
+#define ECV_POINT                               27
+#define ECV_PIPPOINTS                           28
+#define ECV_THREADID                            29
+#define ECV_HCHART                              30
+#define ECV_HCHARTWINDOW                        31
+#define ECV_TESTING                             32
+#define ECV_VISUALMODE                          33
+#define ECV_OPTIMIZATION                        34
+#define ECV_EXTREPORTING                        35
+#define ECV_RECORDEQUITY                        36
+#define ECV_MQLERROR                            37
+#define ECV_DLLERROR                            38
+#define ECV_DLLWARNING                          39
+#define ECV_LOGLEVEL                            40
+#define ECV_LOGLEVELTERMINAL                    41
+#define ECV_LOGLEVELALERT                       42
+#define ECV_LOGLEVELDEBUGGER                    43
+#define ECV_LOGLEVELFILE                        44
+#define ECV_LOGLEVELMAIL                        45
+#define ECV_LOGLEVELSMS                         46
+
+
+// test fields, see ec_GetTestValues()
+#define TESTV_VERSION                           1        // version of the field list (fields are only appended)
+#define TESTV_ID                                0
+#define TESTV_CREATED                           1
+#define TESTV_STARTTIME                         2
+#define TESTV_ENDTIME                           3
+#define TESTV_BARMODEL                          4
+#define TESTV_BARS                              5
+#define TESTV_TICKS                             6
+#define TESTV_SPREAD                            7
+#define TESTV_TRADEDIRECTIONS                   8
+#define TESTV_REPORTID                          9
+#define TESTV_OPENPOSITIONS                     10
+#define TESTV_OPENLONGPOSITIONS                 11
+#define TESTV_OPENSHORTPOSITIONS                12
+#define TESTV_CLOSEDPOSITIONS                   13
+#define TESTV_CLOSEDLONGPOSITIONS               14
+#define TESTV_CLOSEDSHORTPOSITIONS              15
+#define TESTV_AVGRUNUPPIP                       16
+#define TESTV_AVGLONGRUNUPPIP                   17
+#define TESTV_AVGSHORTRUNUPPIP                  18
+#define TESTV_AVGDRAWDOWNPIP                    19
+#define TESTV_AVGLONGDRAWDOWNPIP                20
+#define TESTV_AVGSHORTDRAWDOWNPIP               21
+#define TESTV_AVGPLPIP                          22
+#define TESTV_AVGLONGPLPIP                      23
+#define TESTV_AVGSHORTPLPIP                     24
+
+
 // file system related constants
 #define MKDIR_PARENT                            1        // create non-existing parent directories as needed => @see CreateDirectory()
 
@@ -320,6 +443,8 @@
 #define INIT_BARS_ON_HIST_UPDATE                4        //
 #define INIT_NO_BARS_REQUIRED                   8        // executable without chart history (scripts only)
 #define INIT_BUFFERED_LOG                      16        // setup a logfile buffer for logging
+#define INIT_BINARY_LOG                        32        // write the logfile in binary format (decode with BinaryLog_Decode)
+#define INIT_COMPRESSED_LOG                    64        // write the logfile in compressed blocks (decompress with Lz_DecompressFile)
 
 
 // MT4 internal messages
@@ -1,9 +1,10 @@
 #pragma once
 #include "struct/rsf/Test.h"
+#include "lib/container/LogBuffer.h"
+#include "lib/container/SegmentedVector.h"
+#include "lib/log/LogFile.h"
 #include <vector>
 
-typedef std::vector<string*> LogBuffer;
-
 
 /**
  * Framework struct EXECUTION_CONTEXT
@@ -97,7 +98,7 @@ struct EXECUTION_CONTEXT {                            // -- offset --- size ---
    int                loglevelMail;                   //       776        4     loglevel of the mail appender                             (var)
    int                loglevelSMS;                    //       780        4     loglevel of the SMS appender                              (var)
 
-   std::ofstream*     logger;                         //       784        4     logger instance                                           (var)
+   LogFile*           logger;                         //       784        4     logger instance                                           (var)
    LogBuffer*         logBuffer;                      //       788        4     log buffer                                                (var)
    char               logFilename[MAX_PATH];          //       792      260     logger filename                                           (var)
 };                                                    // -------------------------------------------------------------------------------------------------------------------------
@@ -190,6 +191,9 @@ int                WINAPI ec_LoglevelSMS         (const EXECUTION_CONTEXT* ec);
 //                        ec.logBuffer
 const char*        WINAPI ec_LogFilename         (const EXECUTION_CONTEXT* ec);
 
+int                WINAPI ec_GetValues           (const EXECUTION_CONTEXT* ec, int version, const int fields[], double values[], int size);
+int                WINAPI ec_GetTestValues       (const EXECUTION_CONTEXT* ec, int version, const int fields[], double values[], int size);
+
 
 // validating setters
 ProgramType        WINAPI ec_SetProgramType         (EXECUTION_CONTEXT* ec, ProgramType        type     );
@@ -264,4 +268,5 @@ const char*        WINAPI lpEXECUTION_CONTEXT_toStr(const EXECUTION_CONTEXT* ec)
 
 // type definitions
 typedef std::vector<EXECUTION_CONTEXT*> ContextChain;       // a chain holds all execution contexts of a single MQL program
-typedef std::vector<ContextChain*>      MqlProgramList;     // list of all MQL programs ever loaded (index: program id)
+typedef SegmentedVector<ContextChain*, 1024, 1024> MqlProgramList;   // list of all MQL programs ever loaded (index: program id), lock-free
+                                                                      // reads, max. 1M programs as program ids are never reused
@@ -1,5 +1,6 @@
 #pragma once
 #include "expander.h"
+#include <map>
 #include <vector>
 
 
@@ -32,14 +33,39 @@ struct ORDER {
    char     comment[MAX_ORDER_COMMENT_LENGTH+1];
 
    double   high;                                  // high/low of the open position
+   datetime highTime;                              // time the high was reached
    double   low;
+   datetime lowTime;                               // time the low was reached
+   double   retrace;                               // max. retracement from the favorable extreme (price units)
+
    double   runupPip;                              // values in pip
+   datetime runupTime;                             // time of the max. favorable excursion
    double   drawdownPip;                           // ...
+   datetime drawdownTime;                          // time of the max. adverse excursion
+   double   retracePip;                            // max. retracement from the favorable extreme before exit
    double   plPip;                                 // ...
 };
 
 typedef std::vector<ORDER*> OrderList;
 
 
+/**
+ * Framework struct ORDER_HISTORY
+ *
+ * A view over closed positions sorted by closeTime. Running totals allow range queries by close time in O(log n).
+ */
+struct ORDER_HISTORY {
+   OrderList           orders;                     // closed positions sorted by closeTime
+   std::vector<double> totalProfit;                // running totals of the net profit (profit + swap + commission)
+   std::vector<double> totalPlPip;                 // running totals of the PL in pip
+};
+
+typedef std::map<int,    ORDER_HISTORY*> OrderHistoryByMagic;
+typedef std::map<string, ORDER_HISTORY*> OrderHistoryBySymbol;
+
+
 // helpers
 char* WINAPI ORDER_toStr(const ORDER* order, BOOL outputDebug = FALSE);
+
+BOOL  WINAPI ORDER_HISTORY_add  (ORDER_HISTORY* history, ORDER* order);
+uint  WINAPI ORDER_HISTORY_query(const ORDER_HISTORY* history, datetime from, datetime to, double* profit = NULL, double* plPip = NULL);
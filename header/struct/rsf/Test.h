@@ -36,6 +36,10 @@ struct TEST {
    OrderList*         closedLongPositions;
    OrderList*         closedShortPositions;
 
+   ORDER_HISTORY*        closedHistory;                  // closed positions sorted by closeTime
+   OrderHistoryByMagic*  closedHistoryByMagic;           // closed positions sorted by closeTime, indexed by magic number
+   OrderHistoryBySymbol* closedHistoryBySymbol;          // closed positions sorted by closeTime, indexed by symbol
+
    double             stat_avgRunupPip;                  // average runup of all trades in pip
    double             stat_avgLongRunupPip;              // average long runup in pip
    double             stat_avgShortRunupPip;             // average short runup in pip
@@ -67,4 +71,5 @@ const char* WINAPI test_SetReportSymbol   (TEST* test, const char* symbol   );
 
 
 // helpers
+void        WINAPI TEST_release(TEST* test);
 char*       WINAPI TEST_toStr(const TEST* test, BOOL outputDebug = FALSE);
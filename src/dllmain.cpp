@@ -1,8 +1,18 @@
 #include "expander.h"
+#include "lib/binarylog.h"
+#include "lib/datetime.h"
+#include "lib/debugchannel.h"
+#include "lib/executioncontext.h"
 #include "lib/helper.h"
+#include "lib/journal.h"
+#include "lib/logwriter.h"
+#include "lib/memory.h"
+#include "lib/profiler.h"
 #include "lib/string.h"
 #include "lib/terminal.h"
 #include "lib/timer.h"
+#include "lib/trigger.h"
+#include "lib/container/SegmentedVector.h"
 #include "lib/lock/Lock.h"
 #include "struct/rsf/ExecutionContext.h"
 
@@ -10,8 +20,9 @@ extern CRITICAL_SECTION              g_terminalMutex;       // mutex for applica
 extern Locks                         g_locks;               // a map holding pointers to fine-granular locks
 
 extern MqlProgramList                g_mqlPrograms;         // all MQL programs: vector<ContextChain> with index = program id
-extern std::vector<DWORD>            g_threads;             // all known threads executing MQL programs
-extern std::vector<uint>             g_threadsPrograms;     // the last MQL program executed by a thread
+extern SegmentedVector<DWORD>        g_threads;             // all known threads executing MQL programs
+extern SegmentedVector<uint>         g_threadsPrograms;     // the last MQL program executed by a thread
+extern DWORD                         g_threadIndexTls;      // TLS slot caching the current thread's index
 extern std::vector<TICK_TIMER_DATA*> g_tickTimers;          // all registered ticktimers
 
 
@@ -33,6 +44,7 @@ extern std::vector<TICK_TIMER_DATA*> g_tickTimers;          // all registered ti
 // forward declarations
 void WINAPI onProcessAttach();
 void WINAPI onProcessDetach(BOOL isTerminating);
+void WINAPI onThreadDetach();
 
 
 /**
@@ -48,7 +60,7 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD reason, LPVOID reserved) {
    switch (reason) {
       case DLL_PROCESS_ATTACH: onProcessAttach();               break;
       case DLL_THREAD_ATTACH :                                  break;
-      case DLL_THREAD_DETACH :                                  break;
+      case DLL_THREAD_DETACH : onThreadDetach();                break;
       case DLL_PROCESS_DETACH: onProcessDetach((BOOL)reserved); break;
    }
    return(TRUE);
@@ -59,12 +71,18 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD reason, LPVOID reserved) {
  * Handler for DLL_PROCESS_ATTACH events.
  */
 void WINAPI onProcessAttach() {
-   g_mqlPrograms    .reserve(128);
-   g_threads        .reserve(512);
-   g_threadsPrograms.reserve(512);
    g_tickTimers     .reserve(32);
 
    InitializeCriticalSection(&g_terminalMutex);
+   g_threadIndexTls = TlsAlloc();
+   if (g_threadIndexTls == TLS_OUT_OF_INDEXES) error(ERR_WIN32_ERROR+GetLastError(), "TlsAlloc()");
+   InitDebugChannel();
+   InitMemory();
+   InitTimeFormatCache();
+   InitProfiler();
+   InitJournal();
+   InitLogWriter();
+   InitBinaryLog();
 
    // the production version of the DLL is locked in memory
    const char* dllName = GetExpanderFileNameA();
@@ -75,21 +93,40 @@ void WINAPI onProcessAttach() {
 }
 
 
+/**
+ * Handler for DLL_THREAD_DETACH events. Called under the loader lock, so the handler must not enter any critical section.
+ */
+void WINAPI onThreadDetach() {
+   ReleaseCurrentThreadIndex();
+   ReleaseThreadScratchBuffer();
+   ReleaseThreadTimeFormatCache();
+}
+
+
 /**
  * Handler for DLL_PROCESS_DETACH events.
  *
  * @param  BOOL isTerminating - whether the DLL is detached because the process is terminating
  */
 void WINAPI onProcessDetach(BOOL isTerminating) {
+   ReleaseLogWriter(isTerminating);                                  // write queued log entries in any case (the writer
+                                                                     // thread is gone, it can't use the debug channel)
    if (isTerminating)
       return;
 
    DeleteCriticalSection(&g_terminalMutex);
+   TlsFree(g_threadIndexTls);
    ReleaseTickTimers();
+   ReleaseTriggerBooks();
+   ReleaseBinaryLog();
+   ReleaseProfiler();
+   ReleaseTimeFormatCache();
+   ReleaseMemory();
    ReleaseWindowProperties();
 
    for (Locks::iterator it=g_locks.begin(), end=g_locks.end(); it != end; ++it) {
       delete it->second;
    }
    g_locks.clear();
+   ReleaseDebugChannel();                                            // following debug output goes to the debugger
 }
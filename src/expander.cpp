@@ -1,5 +1,6 @@
 #include "expander.h"
 #include "lib/conversion.h"
+#include "lib/debugchannel.h"
 #include "lib/executioncontext.h"
 #include "lib/helper.h"
 #include "lib/string.h"
@@ -7,6 +8,17 @@
 
 extern MqlProgramList g_mqlPrograms;                     // all MQL programs: vector<ContextChain> with index = program id
 
+LONG          g_diagLevel = LOG_DEBUG;                   // global diagnostics level
+volatile LONG g_diagLevels[DIAG_MODULES] = {             // effective diagnostics level per module
+   LOG_DEBUG,                                            // DIAG_DEFAULT
+   LOG_DEBUG,                                            // DIAG_EXECUTIONCONTEXT
+   LOG_INFO,                                             // DIAG_LOCK: lock tracing and contention messages are off
+   LOG_DEBUG,                                            // DIAG_LOG
+   LOG_DEBUG,                                            // DIAG_TESTER
+};
+BOOL        g_diagOverrides[DIAG_MODULES] = { FALSE, FALSE, TRUE, FALSE, FALSE };    // whether a module overrides the global level
+const char* g_diagModuleNames[DIAG_MODULES] = { "default", "executioncontext", "lock", "log", "tester" };
+
 
 /**
  * Dump data from a buffer to the debugger output console.
@@ -58,6 +70,138 @@ int WINAPI _dump(const char* fileName, const char* funcName, int line, const voi
 }
 
 
+/**
+ * Set the diagnostics level of the DLL. Modules with an overriding level keep their level. Diagnostics below the compile-time
+ * threshold DIAG_MIN_LEVEL are not available.
+ *
+ * @param  int level - LOG_DEBUG | LOG_INFO | LOG_NOTICE | LOG_WARN | LOG_ERROR | LOG_FATAL | LOG_OFF
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI SetDiagLevel(int level) {
+   if (level!=LOG_OFF && (level < LOG_DEBUG || level > LOG_FATAL || level & (level-1))) return(error(ERR_INVALID_PARAMETER, "invalid parameter level: %d (not a loglevel)", level));
+
+   g_diagLevel = level;
+   for (int i=0; i < DIAG_MODULES; ++i) {
+      if (!g_diagOverrides[i]) InterlockedExchange(&g_diagLevels[i], level);
+   }
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Override the diagnostics level of a single module.
+ *
+ * @param  char* module - module name: "default" | "executioncontext" | "lock" | "log" | "tester"
+ * @param  int   level  - LOG_DEBUG | LOG_INFO | LOG_NOTICE | LOG_WARN | LOG_ERROR | LOG_FATAL | LOG_OFF
+ *                        or NULL to reset the module to the global level
+ * @return BOOL - success status
+ */
+BOOL WINAPI SetDiagModuleLevel(const char* module, int level) {
+   if ((uint)module < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter module: 0x%p (not a valid pointer)", module));
+   if (level && level!=LOG_OFF && (level < LOG_DEBUG || level > LOG_FATAL || level & (level-1))) return(error(ERR_INVALID_PARAMETER, "invalid parameter level: %d (not a loglevel)", level));
+
+   for (int i=0; i < DIAG_MODULES; ++i) {
+      if (StrCompare(module, g_diagModuleNames[i])) {
+         g_diagOverrides[i] = (level != NULL);
+         InterlockedExchange(&g_diagLevels[i], level ? level : g_diagLevel);
+         return(TRUE);
+      }
+   }
+   return(error(ERR_INVALID_PARAMETER, "invalid parameter module: \"%s\" (unknown module)", module));
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Format a debug message with its call location into a buffer. The message is truncated if the buffer is too small.
+ *
+ * @param  char*   buffer     - buffer receiving the null-terminated message
+ * @param  int     size       - buffer size including the terminating null
+ * @param  char*   baseName   - base name of the file of the call
+ * @param  char*   funcName   - function name of the call
+ * @param  int     line       - line of the call
+ * @param  char*   type       - message type prefix (e.g. "WARN: ")
+ * @param  int     error_code - error code to append (if any)
+ * @param  char*   msgFormat  - message with format codes for additional parameters
+ * @param  va_list args       - additional parameters
+ *
+ * @return int - message length
+ */
+int WINAPI DebugOutput_Format(char* buffer, int size, const char* baseName, const char* funcName, int line, const char* type, int error_code, const char* msgFormat, va_list args) {
+   size--;                                                           // leave room for the terminating null
+
+   int length = _snprintf(buffer, size, "MT4Expander::%s::%s(%d)  %s", baseName, funcName, line, type);
+   if (length < 0 || length > size) length = size;                  // truncated
+
+   int n = _vsnprintf(buffer+length, size-length, msgFormat, args);
+   length = (n < 0 || n > size-length) ? size : length+n;
+
+   if (error_code && length < size) {                                // add the error code at the end (if any)
+      n = _snprintf(buffer+length, size-length, "  [%s]", ErrorToStr(error_code));
+      length = (n < 0 || n > size-length) ? size : length+n;
+   }
+   buffer[length] = '\0';
+   return(length);
+}
+
+
+/**
+ * Format a debug message with its call location and write it to the active debug output sinks. With only the debug channel
+ * active the message is formatted directly into the channel's shared memory, without heap allocations, and truncated to the
+ * slot size. The debugger receives the full message.
+ *
+ * @param  char*   fileName   - file name of the call
+ * @param  char*   funcName   - function name of the call
+ * @param  int     line       - line of the call
+ * @param  char*   type       - message type prefix (e.g. "WARN: ")
+ * @param  int     error_code - error code to append (if any)
+ * @param  char*   msgFormat  - message with format codes for additional parameters
+ * @param  va_list args       - additional parameters
+ */
+void WINAPI DebugOutput(const char* fileName, const char* funcName, int line, const char* type, int error_code, const char* msgFormat, va_list args) {
+   LONG sinks = g_debugSinks;
+   if (!sinks) return;
+
+   LONG sequence;
+   DEBUGCHANNEL_SLOT* slot = (sinks & DEBUG_SINK_CHANNEL) ? DebugChannel_Claim(sequence) : NULL;
+
+   // insert the call location at the beginning: {basename.ext(line)}
+   const char* baseName = fileName ? fileName : "";
+   for (const char* c=baseName; *c; ++c) {
+      if (*c=='\\' || *c=='/') baseName = c + 1;
+   }
+
+   if (slot && !(sinks & DEBUG_SINK_DEBUGGER)) {                     // channel only: format into the slot
+      int length = DebugOutput_Format(slot->text, sizeof(slot->text), baseName, funcName, line, type, error_code, msgFormat, args);
+      DebugChannel_Commit(slot, sequence, length);
+      return;
+   }
+
+   // the debugger gets the full message, long messages are allocated
+   char stackBuffer[DEBUGCHANNEL_SLOT_SIZE];
+   int size = _scprintf("MT4Expander::%s::%s(%d)  %s", baseName, funcName, line, type) + _vscprintf(msgFormat, args) + 1;
+   if (error_code) size += _scprintf("  [%s]", ErrorToStr(error_code));
+
+   char* buffer = (size > (int)sizeof(stackBuffer)) ? (char*)malloc(size) : NULL;
+   if (!buffer) {                                                    // the message fits or out of memory (truncated)
+      buffer = stackBuffer;
+      size = sizeof(stackBuffer);
+   }
+   int length = DebugOutput_Format(buffer, size, baseName, funcName, line, type, error_code, msgFormat, args);
+
+   if (slot) {                                                       // the ring slot gets the truncated message
+      int slotLength = std::min(length, (int)sizeof(slot->text)-1);
+      memcpy(slot->text, buffer, slotLength);
+      slot->text[slotLength] = '\0';
+      DebugChannel_Commit(slot, sequence, slotLength);
+   }
+   OutputDebugStringA(buffer);           // @see  limitations at http://www.unixwiz.net/techtips/outputdebugstring.html
+   if (buffer != stackBuffer) free(buffer);
+}
+
+
 /**
  * Print a string to the debugger output console.
  *
@@ -72,25 +216,10 @@ int WINAPI _dump(const char* fileName, const char* funcName, int line, const voi
 int WINAPI _debug(const char* fileName, const char* funcName, int line, const char* msgFormat, ...) {
    if (!msgFormat) msgFormat = "(NULL)";
 
-   // format the variable parameters
-   char* msg = "";
-   if (strlen(msgFormat)) {
-      va_list args;
-      va_start(args, msgFormat);
-      msg = strformat(msgFormat, args);
-      va_end(args);
-   }
-
-   // insert the call location at the beginning: {basename.ext(line)}
-   char baseName[MAX_FNAME], ext[MAX_EXT];
-   if (!fileName) baseName[0] = ext[0] = '\0';
-   else           _splitpath_s(fileName, NULL, 0, NULL, 0, baseName, MAX_FNAME, ext, MAX_EXT);
-   char* fullMsg = strformat("MT4Expander::%s%s::%s(%d)  %s", baseName, ext, funcName, line, msg);
-
-   OutputDebugStringA(fullMsg);           // @see  limitations at http://www.unixwiz.net/techtips/outputdebugstring.html
-   free(fullMsg);
-
-   if (strlen(msgFormat)) free(msg);
+   va_list args;
+   va_start(args, msgFormat);
+   DebugOutput(fileName, funcName, line, "", NO_ERROR, msgFormat, args);
+   va_end(args);
    return(NULL);
 }
 
@@ -109,29 +238,11 @@ int WINAPI _warn(const char* fileName, const char* funcName, int line, int error
    if (!msgFormat)  msgFormat = "(null)";
    if (!*msgFormat) msgFormat = "(empty)";
 
-   // format the variable parameters
    va_list args;
    va_start(args, msgFormat);
-   char* msg = strformat(msgFormat, args);
+   DebugOutput(fileName, funcName, line, "WARN: ", error_code, msgFormat, args);
    va_end(args);
 
-   // insert the call location at the beginning: {basename.ext(line)}
-   char baseName[MAX_FNAME], ext[MAX_EXT];
-   if (!fileName) baseName[0] = ext[0] = '\0';
-   else           _splitpath_s(fileName, NULL, 0, NULL, 0, baseName, MAX_FNAME, ext, MAX_EXT);
-   char* newMsg = strformat("MT4Expander::%s%s::%s(%d)  WARN: %s", baseName, ext, funcName, line, msg);
-   free(msg);
-   msg = newMsg;
-
-   // add the error code at the end (if any)
-   if (error_code) {
-      newMsg = strformat("%s  [%s]", msg, ErrorToStr(error_code));
-      free(msg);
-      msg = newMsg;
-   }
-   OutputDebugStringA(msg);
-   free(msg);
-
    // store the warning in the EXECUTION_CONTEXT of the currently executed MQL program
    if (uint pid = GetLastThreadProgram()) {
       ContextChain &chain = *g_mqlPrograms[pid];
@@ -166,22 +277,11 @@ int WINAPI _error(const char* fileName, const char* funcName, int line, int erro
    if (!msgFormat)  msgFormat = "(null)";
    if (!*msgFormat) msgFormat = "(empty)";
 
-   // format the variable parameters
    va_list args;
    va_start(args, msgFormat);
-   char* msg = strformat(msgFormat, args);
+   DebugOutput(fileName, funcName, line, "ERROR: ", error_code, msgFormat, args);
    va_end(args);
 
-   // insert the call location at the beginning: {basename.ext(line)}
-   char baseName[MAX_FNAME], ext[MAX_EXT];
-   if (!fileName) baseName[0] = ext[0] = '\0';
-   else           _splitpath_s(fileName, NULL, 0, NULL, 0, baseName, MAX_FNAME, ext, MAX_EXT);
-   char* fullMsg = strformat("MT4Expander::%s%s::%s(%d)  ERROR: %s  [%s]", baseName, ext, funcName, line, msg, ErrorToStr(error_code));
-
-   OutputDebugStringA(fullMsg);
-   free(msg);
-   free(fullMsg);
-
    // store the error in the EXECUTION_CONTEXT of the currently executed MQL program
    if (uint pid = GetLastThreadProgram()) {
       ContextChain &chain = *g_mqlPrograms[pid];
@@ -0,0 +1,264 @@
+#include "expander.h"
+#include "lib/accounting.h"
+#include "lib/tester.h"
+#include "struct/rsf/Order.h"
+#include "struct/rsf/Test.h"
+
+#include <algorithm>
+
+
+/**
+ * Return the rate for converting values in quote currency to account currency, derived from a symbol's tick value.
+ *
+ * @param  FXT_HEADER* fxt
+ *
+ * @return double - conversion rate (1 if the symbol's quote currency is the account currency or the rate is unknown)
+ */
+double WINAPI GetConversionRate(const FXT_HEADER* fxt) {
+   if (fxt->tickValue > 0 && fxt->tickSize > 0 && fxt->contractSize > 0)
+      return(fxt->tickValue / (fxt->tickSize * fxt->contractSize));
+   return(1);
+}
+
+
+/**
+ * Return the number of swap days charged for holding a position over the specified time range. A rollover is charged at
+ * each midnight (server time). Rollovers at the weekend are free of charge, the rollover at the triple rollover day counts
+ * three times.
+ *
+ * @param  FXT_HEADER* fxt
+ * @param  datetime    from - open time of the position (server time)
+ * @param  datetime    to   - current time or close time of the position (server time)
+ *
+ * @return uint - number of swap days
+ */
+uint WINAPI GetSwapDays(const FXT_HEADER* fxt, datetime from, datetime to) {
+   uint days = 0;
+
+   for (int day=from/DAY, lastDay=to/DAY; day < lastDay; ++day) {    // the rollover at the end of each day
+      int dow = (day + THURSDAY) % 7;                                // 01.01.1970 was a Thursday
+      if      (dow == SATURDAY || dow == SUNDAY)         continue;
+      else if (dow == (int)fxt->swapTripleRolloverDay)   days += 3;
+      else                                               days++;
+   }
+   return(days);
+}
+
+
+/**
+ * Check the accounting settings of a symbol and warn about unsupported modes. The calculation functions don't warn but fall
+ * back to a default, so the check is done once per FXT header, i.e. once per test.
+ *
+ * @param  FXT_HEADER* fxt
+ *
+ * @return BOOL - whether all modes are supported
+ */
+BOOL WINAPI CheckAccountingModes(const FXT_HEADER* fxt) {
+   BOOL supported = TRUE;
+
+   switch (fxt->profitCalculationMode) {
+      case PROFITCALCMODE_FOREX:
+      case PROFITCALCMODE_CFD:
+      case PROFITCALCMODE_FUTURES: break;
+      default: supported = _FALSE(warn(ERR_NOT_IMPLEMENTED, "unsupported profit calculation mode: %d (using PROFITCALCMODE_FOREX)", fxt->profitCalculationMode));
+   }
+   switch (fxt->swapType) {
+      case SWAPTYPE_POINTS:
+      case SWAPTYPE_BASECURRENCY:
+      case SWAPTYPE_INTEREST:
+      case SWAPTYPE_MARGINCURRENCY: break;
+      default: if (fxt->swapEnabled) supported = _FALSE(warn(ERR_NOT_IMPLEMENTED, "unsupported swap type: %d (swap is not calculated)", fxt->swapType));
+   }
+   switch (fxt->commissionCalculationMode) {
+      case COMM_TYPE_MONEY:
+      case COMM_TYPE_POINTS:
+      case COMM_TYPE_PERCENT: break;
+      default: supported = _FALSE(warn(ERR_NOT_IMPLEMENTED, "unsupported commission calculation mode: %d (commission is not calculated)", fxt->commissionCalculationMode));
+   }
+   switch (fxt->marginCalculationMode) {
+      case MARGINCALCMODE_FOREX:
+      case MARGINCALCMODE_CFD:
+      case MARGINCALCMODE_FUTURES:
+      case MARGINCALCMODE_CFD_LEVERAGE: break;
+      default: supported = _FALSE(warn(ERR_NOT_IMPLEMENTED, "unsupported margin calculation mode: %d (margin is not calculated)", fxt->marginCalculationMode));
+   }
+   return(supported);
+}
+
+
+/**
+ * Calculate the gross profit of a position in account currency according to the symbol's profit calculation mode. An
+ * unsupported mode is calculated as PROFITCALCMODE_FOREX, see CheckAccountingModes().
+ *
+ * @param  FXT_HEADER* fxt
+ * @param  int         type       - position type: OP_BUY | OP_SELL
+ * @param  double      lots       - position size
+ * @param  double      openPrice  - open price
+ * @param  double      closePrice - close price or current price (Bid for long, Ask for short positions)
+ *
+ * @return double - profit
+ */
+double WINAPI CalculateProfit(const FXT_HEADER* fxt, int type, double lots, double openPrice, double closePrice) {
+   double distance = (type == OP_BUY) ? closePrice - openPrice : openPrice - closePrice;
+
+   switch (fxt->profitCalculationMode) {
+      case PROFITCALCMODE_FUTURES:
+         if (fxt->tickSize > 0)
+            return(distance / fxt->tickSize * fxt->tickValue * lots);
+         break;
+
+      case PROFITCALCMODE_FOREX:
+      case PROFITCALCMODE_CFD:
+      default:
+         break;
+   }
+   return(distance * fxt->contractSize * lots * GetConversionRate(fxt));
+}
+
+
+/**
+ * Calculate the accumulated swap of a position in account currency according to the symbol's swap type. An unsupported swap
+ * type is not calculated, see CheckAccountingModes().
+ *
+ * @param  FXT_HEADER* fxt
+ * @param  int         type     - position type: OP_BUY | OP_SELL
+ * @param  double      lots     - position size
+ * @param  double      price    - current price (used by the swap types SWAPTYPE_BASECURRENCY and SWAPTYPE_INTEREST)
+ * @param  datetime    openTime - open time of the position (server time)
+ * @param  datetime    time     - current time (server time)
+ *
+ * @return double - swap
+ */
+double WINAPI CalculateSwap(const FXT_HEADER* fxt, int type, double lots, double price, datetime openTime, datetime time) {
+   if (!fxt->swapEnabled) return(0);
+
+   uint days = GetSwapDays(fxt, openTime, time);
+   if (!days) return(0);
+
+   double value = (type == OP_BUY) ? fxt->swapLongValue : fxt->swapShortValue;
+   double swap;
+
+   switch (fxt->swapType) {
+      case SWAPTYPE_POINTS:         swap = value * fxt->pointSize * fxt->contractSize * lots * GetConversionRate(fxt);               break;
+      case SWAPTYPE_BASECURRENCY:   swap = value * lots * price * GetConversionRate(fxt);                                           break;
+      case SWAPTYPE_INTEREST:       swap = lots * fxt->contractSize * price * value/100/360 * GetConversionRate(fxt);               break;
+      case SWAPTYPE_MARGINCURRENCY: swap = value * lots;                                                                            break;
+      default:
+         return(0);
+   }
+   return(swap * days);
+}
+
+
+/**
+ * Calculate the commission of a position in account currency according to the symbol's commission calculation mode. The
+ * value is charged as configured: once per round-turn or for each single deal (FXT_HEADER.commissionType). An unsupported
+ * mode is not calculated, see CheckAccountingModes().
+ *
+ * @param  FXT_HEADER* fxt
+ * @param  double      lots  - position size
+ * @param  double      price - open price (used by commission type COMM_TYPE_PERCENT)
+ *
+ * @return double - commission amount per charge (a positive value)
+ */
+double WINAPI CalculateCommission(const FXT_HEADER* fxt, double lots, double price) {
+   double commission;
+
+   switch (fxt->commissionCalculationMode) {
+      case COMM_TYPE_MONEY:   commission = fxt->commissionValue * lots;                                                             break;
+      case COMM_TYPE_POINTS:  commission = fxt->commissionValue * fxt->pointSize * fxt->contractSize * lots * GetConversionRate(fxt); break;
+      case COMM_TYPE_PERCENT: commission = lots * fxt->contractSize * price * fxt->commissionValue/100 * GetConversionRate(fxt);    break;
+      default:
+         return(0);
+   }
+   return(commission);
+}
+
+
+/**
+ * Calculate the required margin of a position in account currency according to the symbol's margin calculation mode. The
+ * result doesn't consider hedging. An unsupported mode is not calculated, see CheckAccountingModes().
+ *
+ * @param  FXT_HEADER* fxt
+ * @param  double      lots  - position size
+ * @param  double      price - current price
+ *
+ * @return double - margin
+ */
+double WINAPI CalculateMargin(const FXT_HEADER* fxt, double lots, double price) {
+   double units    = (fxt->marginInit > 0) ? fxt->marginInit : fxt->contractSize;
+   double leverage = fxt->accountLeverage;
+   if (fxt->marginDivider > 0) leverage /= fxt->marginDivider;       // the symbol's leverage relative to the account leverage
+   if (leverage <= 0) leverage = 1;
+
+   switch (fxt->marginCalculationMode) {
+      case MARGINCALCMODE_FOREX:        return(units * lots / leverage * price * GetConversionRate(fxt));
+      case MARGINCALCMODE_CFD:          return(units * lots * price * GetConversionRate(fxt));
+      case MARGINCALCMODE_FUTURES:      return(fxt->marginInit * lots);
+      case MARGINCALCMODE_CFD_LEVERAGE: return(units * lots * price / leverage * GetConversionRate(fxt));
+   }
+   return(0);
+}
+
+
+/**
+ * Calculate profit, swap, commission and margin of all open positions of a test at the current tick in a single call. The
+ * positions are not modified. Hedged lots are charged at the hedged margin rate (FXT_HEADER.marginHedged), split equally
+ * between both sides.
+ *
+ * @param  EXECUTION_CONTEXT* ec      - execution context of the tested expert
+ * @param  int                tickets - array receiving the tickets of the open positions
+ * @param  POSITION_VALUES    values  - array receiving the accounting values of the open positions (MQL: double[][5])
+ * @param  int                size    - size of the passed arrays (may be 0 to query the number of open positions only)
+ *
+ * @return int - number of open positions (may be greater than the array size) or EMPTY (-1) in case of errors
+ */
+int WINAPI Test_GetPositionValues(const EXECUTION_CONTEXT* ec, int tickets[], POSITION_VALUES values[], int size) {
+   if ((uint)ec < MIN_VALID_POINTER)              return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
+   if (ec->programType!=PT_EXPERT || !ec->test)   return(_EMPTY(error(ERR_FUNC_NOT_ALLOWED, "function allowed only in experts under test")));
+   if (size < 0)                                  return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size: %d", size)));
+   if (size && (uint)tickets < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter tickets: 0x%p (not a valid pointer)", tickets)));
+   if (size && (uint)values  < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter values: 0x%p (not a valid pointer)", values)));
+   if (!ec->test->openPositions)                  return(_EMPTY(error(ERR_RUNTIME_ERROR, "invalid OrderList initialization, test.openPositions: NULL")));
+
+   TEST* test = ec->test;
+   if (!test->fxtHeader) test->fxtHeader = Tester_ReadFxtHeader(ec->symbol, ec->timeframe, test->barModel);
+   const FXT_HEADER* fxt = test->fxtHeader;
+   if (!fxt) return(EMPTY);
+
+   OrderList &positions = *test->openPositions;
+   int count = positions.size();
+   if (!size) return(count);
+
+   // hedged lots are charged at the hedged margin rate
+   double longLots = 0, shortLots = 0;
+   for (int i=0; i < count; ++i) {
+      if (positions[i]->type == OP_LONG) longLots  += positions[i]->lots;
+      else                               shortLots += positions[i]->lots;
+   }
+   double hedgedLots = std::min(longLots, shortLots);
+   double hedgedRate = 1;                                            // margin rate of hedged lots per side
+   if (fxt->marginHedged > 0) hedgedRate = fxt->marginHedged / ((fxt->marginInit > 0) ? fxt->marginInit : fxt->contractSize) / 2;
+
+   for (int i=0; i < count && i < size; ++i) {
+      ORDER* order = positions[i];
+      double price    = (order->type == OP_LONG) ? ec->bid : ec->ask;
+      double sideLots = (order->type == OP_LONG) ? longLots : shortLots;
+      double hedged   = hedgedLots / sideLots;                       // hedged share of the position
+
+      POSITION_VALUES &pv = values[i];
+      pv.profit     = CalculateProfit(fxt, order->type, order->lots, order->openPrice, price);
+      pv.swap       = CalculateSwap  (fxt, order->type, order->lots, price, order->openTime, ec->currTickTime);
+      if (order->commission) pv.commission = order->commission;
+      else {
+         pv.commission = -CalculateCommission(fxt, order->lots, order->openPrice);
+         if (fxt->commissionType == COMMISSION_PER_DEAL) pv.commission *= 2;    // charged for opening and closing deal
+      }
+      pv.margin     = CalculateMargin(fxt, order->lots, price) * ((1 - hedged) + hedged * hedgedRate);
+      pv.netProfit  = pv.profit + pv.swap + pv.commission;
+
+      tickets[i]    = order->ticket;
+   }
+   return(count);
+   #pragma EXPANDER_EXPORT
+}
@@ -0,0 +1,438 @@
+#define DIAG_MODULE DIAG_LOG
+#include "expander.h"
+#include "lib/binarylog.h"
+#include "lib/conversion.h"
+#include "lib/datetime.h"
+#include "lib/file.h"
+#include "lib/logwriter.h"
+#include "lib/memory.h"
+#include "lib/string.h"
+
+#include <fstream>
+#include <map>
+
+
+#define FNV_OFFSET_BASIS   14695981039346656037ULL
+#define FNV_PRIME                1099511628211ULL
+
+
+// dictionary of the strings interned in a binary logfile, linked to its logger instance
+struct BINLOG_DICTIONARY {
+   std::map<uint64, uint> ids;                              // string hash => string id
+   uint                   nextId;                           // id of the next string to intern
+};
+
+CRITICAL_SECTION g_binaryLogMutex;                          // guards the dictionaries and the order of definitions
+
+
+/**
+ * Initialize the binary log. Called only in DLL::onProcessAttach().
+ */
+void WINAPI InitBinaryLog() {
+   InitializeCriticalSection(&g_binaryLogMutex);
+}
+
+
+/**
+ * Release the binary log. Called only in DLL::onProcessDetach().
+ */
+void WINAPI ReleaseBinaryLog() {
+   DeleteCriticalSection(&g_binaryLogMutex);
+}
+
+
+/**
+ * Split a log message into an argument-free pattern and its numeric arguments. Linebreaks are replaced the same way as in
+ * the text log. Returns the hash of the pattern, the arguments and (on request) the pattern itself.
+ *
+ * @param  char*   message             - log message
+ * @param  char*   args                - buffer receiving the arguments as { uchar length; char text[length]; } (may be NULL)
+ * @param  uint*   argsSize            - variable receiving the size of the arguments in bytes
+ * @param  uint*   argsCount           - variable receiving the number of arguments
+ * @param  string* pattern  [optional] - string receiving the pattern (default: none)
+ *
+ * @return uint64 - pattern hash (FNV-1a)
+ */
+uint64 WINAPI BinaryLog_ScanMessage(const char* message, char* args, uint* argsSize, uint* argsCount, string* pattern = NULL) {
+   uint64 hash = FNV_OFFSET_BASIS;
+   uint size = 0, count = 0;
+   char ch;
+
+   for (const char* c=message; *c; ) {
+      if (*c >= '0' && *c <= '9' && count < BINLOG_MAX_ARGS) {       // cut out a numeric argument
+         const char* start = c;
+         while (((*c >= '0' && *c <= '9') || *c=='.') && c-start < 255) ++c;
+         uint length = c - start;
+         if (args) {
+            args[size] = (char)length;
+            memcpy(args + size + 1, start, length);
+         }
+         size += 1 + length;
+         count++;
+         ch = BINLOG_ARG_PLACEHOLDER;
+      }
+      else {
+         ch = *c++;
+         if      (ch=='\r' && *c=='\n') { ch = ' '; c++; }           // replace linebreaks with spaces
+         else if (ch=='\n')               ch = ' ';
+      }
+      hash = (hash ^ (uchar)ch) * FNV_PRIME;
+      if (pattern) pattern->push_back(ch);
+   }
+
+   *argsSize  = size;
+   *argsCount = count;
+   return(hash);
+}
+
+
+/**
+ * Intern a string in the dictionary of a binary logfile and queue its definition record. Must be called while holding
+ * g_binaryLogMutex, so that the definition is queued before any message using it. Strings exceeding the max. record size
+ * are truncated.
+ *
+ * @param  LogFile*           logger
+ * @param  BINLOG_DICTIONARY& dictionary
+ * @param  uint64             hash       - string hash
+ * @param  char*              text       - string
+ * @param  uint               size       - string size in bytes
+ *
+ * @return uint - id of the interned string
+ */
+uint WINAPI BinaryLog_Define(LogFile* logger, BINLOG_DICTIONARY &dictionary, uint64 hash, const char* text, uint size) {
+   uint id = dictionary.nextId++;
+   dictionary.ids[hash] = id;
+   size = std::min(size, (uint)(BINLOG_MAX_RECORD_SIZE - sizeof(BINLOG_DEFINITION_RECORD)));
+
+   string data(sizeof(BINLOG_DEFINITION_RECORD), '\0');
+   BINLOG_DEFINITION_RECORD* record = (BINLOG_DEFINITION_RECORD*)&data[0];
+   record->size = sizeof(BINLOG_DEFINITION_RECORD) + size;
+   record->type = BINLOG_DEFINITION;
+   record->id   = id;
+   data.append(text, size);
+
+   LogWriter_Append(logger, data.data(), data.size(), TRUE);          // definitions are repeated in every logfile segment
+   return(id);
+}
+
+
+/**
+ * Start a new logging session in a just opened binary logfile: reset the dictionary and write the session header. Sessions
+ * appended to an existing file are decoded independently. Each new segment of a rotated logfile starts with the session
+ * header and all definitions made so far, so segments can be decoded independently, too.
+ *
+ * @param  LogFile* logger - opened logfile without queued entries
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI BinaryLog_Open(LogFile* logger) {
+   if ((uint)logger < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter logger: 0x%p (not a valid pointer)", logger));
+   if (!logger->is_open())               return(error(ERR_INVALID_PARAMETER, "invalid parameter logger: 0x%p (not open)", logger));
+
+   EnterCriticalSection(&g_binaryLogMutex);
+   BINLOG_DICTIONARY* dictionary = logger->dictionary();
+   if (!dictionary) logger->setDictionary(dictionary = new BINLOG_DICTIONARY());
+   dictionary->ids.clear();
+   dictionary->nextId = 1;
+
+   BINLOG_HEADER_RECORD header = {};
+   header.size    = sizeof(header);
+   header.type    = BINLOG_HEADER;
+   header.version = BINLOG_FILE_VERSION;
+   strcpy(header.magic, "RSFBLOG");
+   logger->lock();                                                   // the log writer may be writing to the logfile
+   logger->clearPreamble();
+   BOOL success = logger->append((char*)&header, sizeof(header));
+   logger->addPreamble((char*)&header, sizeof(header));
+   success = success && !logger->fail();
+   logger->unlock();
+   LeaveCriticalSection(&g_binaryLogMutex);
+
+   return(success);
+}
+
+
+/**
+ * Queue a log message in binary format. Instead of a formatted text line a compact record is written: the execution path
+ * and the message pattern are interned once per session and referenced by id, the numeric arguments of the message are
+ * stored as raw text. In steady state (all strings interned) the function doesn't format anything and doesn't allocate.
+ *
+ * @param  EXECUTION_CONTEXT* ec      - execution context of the logging module
+ * @param  LogFile*           logger  - opened binary logfile, see BinaryLog_Open()
+ * @param  datetime           time    - current time (used only in tester)
+ * @param  char*              message - log message
+ * @param  int                error   - error linked to the message (if any)
+ * @param  int                level   - log level of the message
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI BinaryLog_Append(const EXECUTION_CONTEXT* ec, LogFile* logger, datetime time, const char* message, int error, int level) {
+   char* buffer = GetScratchBuffer(sizeof(BINLOG_MESSAGE_RECORD) + 2*strlen(message));
+   if (!buffer) return(FALSE);
+
+   BINLOG_MESSAGE_RECORD* record = (BINLOG_MESSAGE_RECORD*)buffer;
+   uint argsSize, argsCount;
+   uint64 messageHash = BinaryLog_ScanMessage(message, buffer + sizeof(BINLOG_MESSAGE_RECORD), &argsSize, &argsCount);
+
+   BOOL isLibrary = (ec->moduleType == MT_LIBRARY);
+   uint64 moduleHash = (FNV_OFFSET_BASIS ^ 'M') * FNV_PRIME;         // separate the hash domains of paths and patterns
+   for (const char* c=ec->symbol;      *c; ++c) moduleHash = (moduleHash ^ (uchar)*c) * FNV_PRIME;
+   moduleHash = (moduleHash ^ (uint)ec->timeframe) * FNV_PRIME;
+   for (const char* c=ec->programName; *c; ++c) moduleHash = (moduleHash ^ (uchar)*c) * FNV_PRIME;
+   if (isLibrary) {
+      moduleHash = (moduleHash ^ ':') * FNV_PRIME;
+      for (const char* c=ec->moduleName; *c; ++c) moduleHash = (moduleHash ^ (uchar)*c) * FNV_PRIME;
+   }
+
+   EnterCriticalSection(&g_binaryLogMutex);
+   BINLOG_DICTIONARY* dictionary = logger->dictionary();             // linked to the logger: no registry lookup
+   if (!dictionary) {
+      LeaveCriticalSection(&g_binaryLogMutex);
+      return(error(ERR_ILLEGAL_STATE, "binary logfile not opened: logger=0x%p", logger));
+   }
+
+   std::map<uint64, uint>::iterator entry = dictionary->ids.find(moduleHash);
+   if (entry != dictionary->ids.end()) record->module = entry->second;
+   else {
+      char path[MAX_PATH*2];
+      int size = sprintf_s(path, sizeof(path), "%s,%s  %s::%s%s", ec->symbol, PeriodDescription(ec->timeframe), ec->programName, (isLibrary ? ec->moduleName : ""), (isLibrary ? "::" : ""));
+      record->module = BinaryLog_Define(logger, *dictionary, moduleHash, path, std::max(size, 0));
+   }
+
+   entry = dictionary->ids.find(messageHash);
+   if (entry != dictionary->ids.end()) record->message = entry->second;
+   else {
+      string pattern;
+      BinaryLog_ScanMessage(message, NULL, &argsSize, &argsCount, &pattern);
+      record->message = BinaryLog_Define(logger, *dictionary, messageHash, pattern.data(), pattern.size());
+   }
+   LeaveCriticalSection(&g_binaryLogMutex);
+
+   record->size  = sizeof(BINLOG_MESSAGE_RECORD) + argsSize;
+   record->type  = BINLOG_MESSAGE;
+   record->flags = ec->testing ? BINLOG_TESTER : 0;
+   record->level = level;
+   record->pid   = ec->pid;
+   record->error = error;
+   record->args  = (uchar)argsCount;
+
+   if (ec->testing) {
+      record->time = time;
+   }
+   else {
+      SYSTEMTIME st; FILETIME ft;
+      GetLocalTime(&st);
+      SystemTimeToFileTime(&st, &ft);
+      record->time = ((uint64)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+   }
+   return(LogWriter_Append(logger, buffer, record->size));           // written asynchronously
+}
+
+
+/**
+ * Queue a block of preformatted text lines for a binary logfile, e.g. the content of a log buffer. Blocks exceeding the max.
+ * record size are split into multiple records.
+ *
+ * @param  LogFile* logger - opened binary logfile
+ * @param  char*    text   - text lines including the line breaks
+ * @param  uint     size   - text size in bytes
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI BinaryLog_AppendText(LogFile* logger, const char* text, uint size) {
+   if ((uint)logger < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter logger: 0x%p (not a valid pointer)", logger));
+   if ((uint)text < MIN_VALID_POINTER)   return(error(ERR_INVALID_PARAMETER, "invalid parameter text: 0x%p (not a valid pointer)", text));
+
+   const uint maxChunk = BINLOG_MAX_RECORD_SIZE - sizeof(BINLOG_RECORD);
+   string data;
+   BOOL success = TRUE;
+
+   while (size) {
+      uint chunk = std::min(size, maxChunk);
+      data.assign(sizeof(BINLOG_RECORD), '\0');                      // a single append keeps the record in one segment
+      BINLOG_RECORD* record = (BINLOG_RECORD*)&data[0];
+      record->size = sizeof(BINLOG_RECORD) + chunk;
+      record->type = BINLOG_TEXT;
+      data.append(text, chunk);
+
+      success = LogWriter_Append(logger, data.data(), data.size()) && success;
+      text += chunk;
+      size -= chunk;
+   }
+   return(success);
+}
+
+
+/**
+ * Release the dictionary of a binary logfile. Must be called before the logger instance is deleted.
+ *
+ * @param  LogFile* logger
+ */
+void WINAPI BinaryLog_Release(LogFile* logger) {
+   EnterCriticalSection(&g_binaryLogMutex);
+   delete logger->dictionary();
+   logger->setDictionary(NULL);
+   LeaveCriticalSection(&g_binaryLogMutex);
+}
+
+
+/**
+ * Return the position of a session header in a block of binary log data.
+ *
+ * @param  char* data
+ * @param  uint  size    - data size in bytes
+ * @param  char* pattern - start of a session header: size, type and magic
+ * @param  uint  length  - length of the pattern
+ *
+ * @return int - offset of the session header in the data or EMPTY (-1) if the data contains no session header
+ */
+int WINAPI BinaryLog_FindHeader(const char* data, uint size, const char* pattern, uint length) {
+   for (uint i=0; i+length <= size; ++i) {
+      if (data[i]==pattern[0] && !memcmp(data + i, pattern, length)) return(i);
+   }
+   return(EMPTY);
+}
+
+
+/**
+ * Decode a binary logfile to a text file in the format of the regular text log. One line per log message. A truncated or
+ * corrupt record (e.g. torn by a crash, with a new session appended after it) is skipped with a warning, decoding continues
+ * with the next session header.
+ *
+ * @param  char* binaryFile - full filename of the binary logfile
+ * @param  char* outputFile - full filename of the text file to create
+ *
+ * @return int - number of decoded messages or EMPTY (-1) in case of errors
+ */
+int WINAPI BinaryLog_Decode(const char* binaryFile, const char* outputFile) {
+   if ((uint)binaryFile < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter binaryFile: 0x%p (not a valid pointer)", binaryFile)));
+   if (!*binaryFile)                         return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter binaryFile: \"\" (empty)")));
+   if ((uint)outputFile < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter outputFile: 0x%p (not a valid pointer)", outputFile)));
+   if (!*outputFile)                         return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter outputFile: \"\" (empty)")));
+
+   std::ifstream input(binaryFile, std::ios::binary);
+   if (!input.is_open()) return(_EMPTY(error(ERR_WIN32_ERROR+GetLastError(), "cannot open file \"%s\" (%s)", binaryFile, strerror(errno))));
+
+   std::ofstream output(outputFile, std::ios::binary|std::ios::trunc);
+   if (!output.is_open()) return(_EMPTY(error(ERR_WIN32_ERROR+GetLastError(), "cannot open file \"%s\" (%s)", outputFile, strerror(errno))));
+
+   std::map<uint, string> dictionary;
+   std::vector<char> data;
+   BINLOG_RECORD head;
+   BOOL hasHeader = FALSE;
+   string line;
+   char sTime[32];
+   int messages = 0;
+   int64 offset = 0;                                                 // file offset of the current record
+
+   BINLOG_HEADER_RECORD sync = {};                                   // resync pattern: size, type and magic of a session header
+   sync.size = sizeof(sync);
+   sync.type = BINLOG_HEADER;
+   strcpy(sync.magic, "RSFBLOG");
+   const uint syncLength = offsetof(BINLOG_HEADER_RECORD, version);
+
+   while (input.read((char*)&head, sizeof(head))) {
+      const char* corrupt = NULL;
+      int torn = EMPTY;
+
+      if (head.size < sizeof(head) || head.size > BINLOG_MAX_RECORD_SIZE) {
+         corrupt = "invalid record size";
+      }
+      else {
+         data.resize(head.size);
+         memcpy(&data[0], &head, sizeof(head));
+         if (head.size > sizeof(head) && !input.read(&data[sizeof(head)], head.size-sizeof(head))) corrupt = "truncated record";
+         else if (head.type != BINLOG_HEADER) {                      // a session header inside a record: the record was torn
+            torn = BinaryLog_FindHeader(&data[1], head.size-1, (char*)&sync, syncLength);
+            if (torn != EMPTY) corrupt = "torn record";
+         }
+      }
+      if (corrupt) {
+         if (!hasHeader) return(_EMPTY(error(ERR_RUNTIME_ERROR, "not a binary logfile: \"%s\"", binaryFile)));
+         warn(ERR_RUNTIME_ERROR, "corrupt record in binary logfile \"%s\" at offset %I64d (%s), skipping to the next session", binaryFile, offset, corrupt);
+         input.clear();
+         if (torn != EMPTY) {
+            offset += 1 + torn;
+            input.seekg(offset);
+         }
+         else {
+            input.seekg(offset + 1);
+            offset = FindInStream(input, (char*)&sync, syncLength);
+            if (offset < 0) break;
+         }
+         continue;
+      }
+      offset += head.size;
+
+      if (head.type == BINLOG_HEADER) {
+         const BINLOG_HEADER_RECORD* header = (BINLOG_HEADER_RECORD*)&data[0];
+         if (head.size < sizeof(*header) || memcmp(header->magic, "RSFBLOG", 8)) return(_EMPTY(error(ERR_RUNTIME_ERROR, "not a binary logfile: \"%s\"", binaryFile)));
+         if (header->version != BINLOG_FILE_VERSION)                             return(_EMPTY(error(ERR_RUNTIME_ERROR, "unsupported binary log version %d in file \"%s\"", header->version, binaryFile)));
+         dictionary.clear();                                         // a new logging session
+         hasHeader = TRUE;
+         continue;
+      }
+      if (!hasHeader) return(_EMPTY(error(ERR_RUNTIME_ERROR, "not a binary logfile: \"%s\"", binaryFile)));
+
+      switch (head.type) {
+         case BINLOG_DEFINITION: {
+            if (head.size < sizeof(BINLOG_DEFINITION_RECORD)) break;
+            const BINLOG_DEFINITION_RECORD* record = (BINLOG_DEFINITION_RECORD*)&data[0];
+            dictionary[record->id].assign(&data[0] + sizeof(*record), head.size - sizeof(*record));
+            break;
+         }
+
+         case BINLOG_TEXT:
+            output.write(&data[0] + sizeof(head), head.size - sizeof(head));
+            break;
+
+         case BINLOG_MESSAGE: {
+            if (head.size < sizeof(BINLOG_MESSAGE_RECORD)) break;
+            const BINLOG_MESSAGE_RECORD* record = (BINLOG_MESSAGE_RECORD*)&data[0];
+
+            if (record->flags & BINLOG_TESTER) {
+               line.assign("Tester ");
+               gmtimeFormat(sTime, sizeof(sTime), (datetime)record->time, "%Y-%m-%d %H:%M:%S");
+               line.append(sTime);
+            }
+            else {
+               FILETIME ft = { (DWORD)record->time, (DWORD)(record->time >> 32) };
+               SYSTEMTIME st;
+               FileTimeToSystemTime(&ft, &st);
+               sprintf_s(sTime, sizeof(sTime), "%04d-%02d-%02d %02d:%02d:%02d.%03d", st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
+               line.assign(sTime);
+            }
+            sprintf_s(sTime, sizeof(sTime), " %-6s ", (record->level==LOG_INFO) ? "" : LoglevelDescriptionA(record->level));
+            line.append(sTime);
+
+            std::map<uint, string>::iterator module = dictionary.find(record->module);
+            if (module != dictionary.end()) line.append(module->second);
+            else                            line.append("(undefined path "+ to_string(record->module) +")::");
+
+            std::map<uint, string>::iterator pattern = dictionary.find(record->message);
+            if (pattern == dictionary.end()) line.append("(undefined message "+ to_string(record->message) +")");
+            else {
+               const char* arg = &data[0] + sizeof(*record), *argsEnd = &data[0] + head.size;
+               for (string::const_iterator c=pattern->second.begin(), end=pattern->second.end(); c != end; ++c) {
+                  if (*c==BINLOG_ARG_PLACEHOLDER && arg < argsEnd) {
+                     uint length = std::min((uint)(uchar)*arg, (uint)(argsEnd-arg-1));
+                     line.append(arg+1, length);
+                     arg += 1 + length;
+                  }
+                  else line.push_back(*c);
+               }
+            }
+            if (record->error) line.append("  [").append(ErrorToStr(record->error)).append("]");
+
+            output << line << "\n";
+            messages++;
+            break;
+         }
+      }                                                              // unknown record types are skipped
+   }
+   output.close();
+
+   if (output.fail()) return(_EMPTY(error(ERR_WIN32_ERROR+GetLastError(), "cannot write file \"%s\" (%s)", outputFile, strerror(errno))));
+   return(messages);
+   #pragma EXPANDER_EXPORT
+}
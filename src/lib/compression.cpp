@@ -0,0 +1,280 @@
+#include "expander.h"
+#include "lib/compression.h"
+#include "lib/file.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+
+/**
+ * Read 4 unaligned bytes.
+ *
+ * @param  uchar* p
+ *
+ * @return uint
+ */
+uint WINAPI Lz_Read32(const uchar* p) {
+   uint value;
+   memcpy(&value, p, sizeof(value));
+   return(value);
+}
+
+
+/**
+ * Write a variable-length extension of a token length (a sequence of 255 bytes terminated by a smaller byte).
+ *
+ * @param  uchar* &out    - output position (updated)
+ * @param  uint    length - length exceeding the token's 4-bit field
+ */
+void WINAPI Lz_WriteLength(uchar* &out, uint length) {
+   for (; length >= 255; length -= 255) {
+      *out++ = 255;
+   }
+   *out++ = (uchar)length;
+}
+
+
+/**
+ * Read a variable-length extension of a token length.
+ *
+ * @param  uchar* &in     - input position (updated)
+ * @param  uchar*  inEnd  - end of the input
+ * @param  uint   &length - length to extend
+ *
+ * @return BOOL - success status (FALSE if the input is truncated)
+ */
+BOOL WINAPI Lz_ReadLength(const uchar* &in, const uchar* inEnd, uint &length) {
+   uchar value;
+   do {
+      if (in >= inEnd) return(FALSE);
+      value = *in++;
+      length += value;
+   } while (value == 255);
+   return(TRUE);
+}
+
+
+/**
+ * Write a sequence of literals optionally followed by a back-reference. A sequence starts with a token holding both lengths
+ * in 4 bits each, longer lengths are extended by additional bytes.
+ *
+ * @param  uchar* &out           - output position (updated)
+ * @param  uchar*  outEnd        - end of the output buffer
+ * @param  uchar*  literals      - literals to copy
+ * @param  uint    literalLength - number of literals
+ * @param  uint    offset        - distance of the back-reference
+ * @param  uint    matchLength   - length of the back-reference (0: the last sequence of a block without back-reference)
+ *
+ * @return BOOL - success status (FALSE if the output buffer is too small)
+ */
+BOOL WINAPI Lz_WriteSequence(uchar* &out, const uchar* outEnd, const uchar* literals, uint literalLength, uint offset, uint matchLength) {
+   uint required = 1 + literalLength/255 + 1 + literalLength;
+   if (matchLength) required += 2 + (matchLength-LZ_MIN_MATCH)/255 + 1;
+   if ((uint)(outEnd-out) < required) return(FALSE);
+
+   uchar* token = out++;
+   *token = (uchar)(std::min(literalLength, 15U) << 4);
+   if (literalLength >= 15) Lz_WriteLength(out, literalLength-15);
+   memcpy(out, literals, literalLength);
+   out += literalLength;
+
+   if (matchLength) {
+      *out++ = (uchar)offset;                                        // little-endian 16 bit offset
+      *out++ = (uchar)(offset >> 8);
+      uint length = matchLength - LZ_MIN_MATCH;
+      *token |= (uchar)std::min(length, 15U);
+      if (length >= 15) Lz_WriteLength(out, length-15);
+   }
+   return(TRUE);
+}
+
+
+/**
+ * Compress a block with a fast LZ77 compressor. The match finder uses a single-entry hash table of 4-byte sequences, it
+ * favours speed over compression ratio. Blocks are independent of each other.
+ *
+ * @param  char* src      - data to compress
+ * @param  uint  srcSize  - data size (max. LZ_MAX_BLOCK_SIZE)
+ * @param  char* dest     - output buffer
+ * @param  uint  destSize - output buffer size (LZ_BOUND(srcSize) is always sufficient)
+ *
+ * @return uint - compressed size or 0 if the output buffer is too small (i.e. the data is not compressible)
+ */
+uint WINAPI Lz_Compress(const char* src, uint srcSize, char* dest, uint destSize) {
+   if (srcSize > LZ_MAX_BLOCK_SIZE) return(_NULL(error(ERR_INVALID_PARAMETER, "invalid parameter srcSize: %d (max. %d)", srcSize, LZ_MAX_BLOCK_SIZE)));
+
+   const uchar* in = (const uchar*)src;
+   uchar* out = (uchar*)dest, *outEnd = out + destSize;
+   WORD table[1 << LZ_HASH_BITS] = {0};                              // last position of each hashed sequence
+   uint pos = 0, anchor = 0;
+
+   if (srcSize > LZ_MIN_MATCH) {
+      uint limit = srcSize - LZ_MIN_MATCH;                           // last position a match can start
+      while (pos <= limit) {
+         uint sequence  = Lz_Read32(in + pos);
+         uint hash      = (sequence * 2654435761U) >> (32-LZ_HASH_BITS);
+         uint candidate = table[hash];
+         table[hash] = (WORD)pos;
+
+         if (candidate >= pos || Lz_Read32(in + candidate) != sequence) {
+            pos += 1 + ((pos-anchor) >> 6);                          // skip faster through incompressible data
+            continue;
+         }
+         uint length = LZ_MIN_MATCH;
+         while (pos+length < srcSize && in[candidate+length]==in[pos+length]) length++;
+
+         if (!Lz_WriteSequence(out, outEnd, in + anchor, pos-anchor, pos-candidate, length)) return(0);
+         pos   += length;
+         anchor = pos;
+      }
+   }
+   if (!Lz_WriteSequence(out, outEnd, in + anchor, srcSize-anchor, 0, 0)) return(0);
+   return(out - (uchar*)dest);
+}
+
+
+/**
+ * Decompress a block compressed by Lz_Compress().
+ *
+ * @param  char* src      - compressed data
+ * @param  uint  srcSize  - compressed size
+ * @param  char* dest     - output buffer
+ * @param  uint  destSize - output buffer size
+ *
+ * @return int - decompressed size or EMPTY (-1) if the data is corrupt or the output buffer is too small
+ */
+int WINAPI Lz_Decompress(const char* src, uint srcSize, char* dest, uint destSize) {
+   const uchar* in = (const uchar*)src, *inEnd = in + srcSize;
+   uchar* out = (uchar*)dest, *outEnd = out + destSize;
+
+   while (in < inEnd) {
+      uint token = *in++;
+      uint literalLength = token >> 4;
+      if (literalLength == 15 && !Lz_ReadLength(in, inEnd, literalLength)) return(EMPTY);
+      if (literalLength > (uint)(inEnd-in) || literalLength > (uint)(outEnd-out)) return(EMPTY);
+      memcpy(out, in, literalLength);
+      in  += literalLength;
+      out += literalLength;
+      if (in == inEnd) break;                                        // the last sequence has no back-reference
+
+      if (inEnd-in < 2) return(EMPTY);
+      uint offset = in[0] | in[1] << 8;
+      in += 2;
+      if (!offset || offset > (uint)(out-(uchar*)dest)) return(EMPTY);
+
+      uint matchLength = token & 15;
+      if (matchLength == 15 && !Lz_ReadLength(in, inEnd, matchLength)) return(EMPTY);
+      matchLength += LZ_MIN_MATCH;
+      if (matchLength > (uint)(outEnd-out)) return(EMPTY);
+
+      const uchar* match = out - offset;                             // byte-wise: source and target may overlap
+      while (matchLength--) *out++ = *match++;
+   }
+   return(out - (uchar*)dest);
+}
+
+
+/**
+ * Compress a block and write it with its block header. Incompressible data is stored uncompressed.
+ *
+ * @param  std::ostream &output - stream to write to
+ * @param  char*         data   - data to write
+ * @param  uint          size   - data size (max. LZ_MAX_BLOCK_SIZE)
+ * @param  char*         buffer - scratch buffer of at least LZ_BOUND(LZ_MAX_BLOCK_SIZE) bytes
+ *
+ * @return uint - number of bytes written
+ */
+uint WINAPI Lz_WriteBlock(std::ostream &output, const char* data, uint size, char* buffer) {
+   if (!size) return(0);
+
+   LZ_BLOCK_HEADER header;
+   memcpy(header.magic, LZ_BLOCK_MAGIC, sizeof(header.magic));
+   header.rawSize = size;
+   header.size = Lz_Compress(data, size, buffer, size-1);            // compressed data must be smaller than the raw data
+   if (!header.size) {
+      header.size = size;
+      buffer = (char*)data;
+   }
+   header.checksum = 2166136261U;
+   for (uint i=0; i < header.size; ++i) {
+      header.checksum = (header.checksum ^ (uchar)buffer[i]) * 16777619U;
+   }
+   output.write((char*)&header, sizeof(header));
+   output.write(buffer, header.size);
+   return(sizeof(header) + header.size);
+}
+
+
+/**
+ * Decompress a compressed logfile. A truncated or corrupt block (e.g. torn by a crash, with a new session appended after it)
+ * is skipped with a warning, decompression continues with the next valid block.
+ *
+ * @param  char* compressedFile - full filename of the compressed logfile
+ * @param  char* outputFile     - full filename of the text file to create
+ *
+ * @return double - number of decompressed bytes or EMPTY (-1) in case of errors
+ */
+double WINAPI Lz_DecompressFile(const char* compressedFile, const char* outputFile) {
+   if ((uint)compressedFile < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter compressedFile: 0x%p (not a valid pointer)", compressedFile)));
+   if (!*compressedFile)                         return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter compressedFile: \"\" (empty)")));
+   if ((uint)outputFile < MIN_VALID_POINTER)     return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter outputFile: 0x%p (not a valid pointer)", outputFile)));
+   if (!*outputFile)                             return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter outputFile: \"\" (empty)")));
+
+   std::ifstream input(compressedFile, std::ios::binary);
+   if (!input.is_open()) return(_EMPTY(error(ERR_WIN32_ERROR+GetLastError(), "cannot open file \"%s\" (%s)", compressedFile, strerror(errno))));
+
+   std::ofstream output(outputFile, std::ios::binary|std::ios::trunc);
+   if (!output.is_open()) return(_EMPTY(error(ERR_WIN32_ERROR+GetLastError(), "cannot open file \"%s\" (%s)", outputFile, strerror(errno))));
+
+   std::vector<char> data(LZ_BOUND(LZ_MAX_BLOCK_SIZE)), block(LZ_MAX_BLOCK_SIZE);
+   LZ_BLOCK_HEADER header;
+   uint64 bytes = 0;
+   int64 offset = 0;                                                 // file offset of the current block
+
+   while (input.read((char*)&header, sizeof(header))) {
+      const char* corrupt = NULL;
+      int size = header.rawSize;
+
+      if (memcmp(header.magic, LZ_BLOCK_MAGIC, sizeof(header.magic))) {
+         if (!offset) return(_EMPTY(error(ERR_RUNTIME_ERROR, "not a compressed logfile: \"%s\"", compressedFile)));
+         corrupt = "invalid block header";
+      }
+      else if (header.rawSize > LZ_MAX_BLOCK_SIZE || header.size > header.rawSize) {
+         corrupt = "invalid block size";
+      }
+      else if (!input.read(&data[0], header.size)) {
+         corrupt = "truncated block";
+      }
+      else {
+         uint checksum = 2166136261U;
+         for (uint i=0; i < header.size; ++i) {
+            checksum = (checksum ^ (uchar)data[i]) * 16777619U;
+         }
+         if (checksum != header.checksum)   corrupt = "checksum mismatch";
+         else if (header.size != header.rawSize) {
+            size = Lz_Decompress(&data[0], header.size, &block[0], header.rawSize);
+            if (size != (int)header.rawSize) corrupt = "invalid compressed data";
+         }
+      }
+
+      if (corrupt) {                                                 // resync at the next block magic
+         warn(ERR_RUNTIME_ERROR, "corrupt block in compressed logfile \"%s\" at offset %I64d (%s), skipping to the next block", compressedFile, offset, corrupt);
+         input.clear();
+         input.seekg(offset + 1);
+         offset = FindInStream(input, LZ_BLOCK_MAGIC, sizeof(header.magic));
+         if (offset < 0) break;
+         continue;
+      }
+
+      if (header.size == header.rawSize) output.write(&data[0], header.size);   // a stored block
+      else                               output.write(&block[0], size);
+      bytes += header.rawSize;
+      offset += sizeof(header) + header.size;
+   }
+   output.close();
+
+   if (output.fail()) return(_EMPTY(error(ERR_WIN32_ERROR+GetLastError(), "cannot write file \"%s\" (%s)", outputFile, strerror(errno))));
+   return((double)bytes);
+   #pragma EXPANDER_EXPORT
+}
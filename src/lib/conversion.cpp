@@ -710,6 +710,9 @@ char* WINAPI InitFlagsToStr(DWORD flags) {
    if (flags & INIT_PIPVALUE           ) str.append("|INIT_PIPVALUE"           );
    if (flags & INIT_BARS_ON_HIST_UPDATE) str.append("|INIT_BARS_ON_HIST_UPDATE");
    if (flags & INIT_NO_BARS_REQUIRED   ) str.append("|INIT_NO_BARS_REQUIRED"   );
+   if (flags & INIT_BUFFERED_LOG       ) str.append("|INIT_BUFFERED_LOG"       );
+   if (flags & INIT_BINARY_LOG         ) str.append("|INIT_BINARY_LOG"         );
+   if (flags & INIT_COMPRESSED_LOG     ) str.append("|INIT_COMPRESSED_LOG"     );
    if (!str.length())                    str.append("|"+ to_string(flags)      );
 
    return(strcpy(new char[str.length()], str.c_str()+1));            // skip the leading "|"
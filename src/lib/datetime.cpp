@@ -1,8 +1,150 @@
 #include "expander.h"
+#include "lib/datetime.h"
+#include "lib/memory.h"
+#include "lib/container/SegmentedVector.h"
 
 #include <time.h>
 
 
+extern CRITICAL_SECTION g_terminalMutex;                    // mutex for application-wide locking
+
+struct TIME_FORMAT {                                        // the last formatted time of a thread per time base
+   uint64 key;                                              // seconds identifying the formatted time
+   char   format[32];                                       // format control string (longer formats are not cached)
+   char   text[64];                                         // formatted time
+   size_t length;
+};
+struct TIME_FORMAT_CACHE {
+   TIME_FORMAT gmtime;                                      // gmtimeFormat()
+   TIME_FORMAT localtime;                                   // localtimeFormat(datetime)
+   TIME_FORMAT systemtime;                                  // localtimeFormat(SYSTEMTIME)
+   uint        slot;                                        // index in g_timeFormatCaches or EMPTY if not registered
+};
+SegmentedVector<TIME_FORMAT_CACHE*> g_timeFormatCaches;     // time format caches of all live threads (NULL: free slot)
+volatile LONG g_freeTimeFormatSlots;                        // number of free slots in g_timeFormatCaches
+DWORD g_timeFormatTls = TLS_OUT_OF_INDEXES;                 // TLS slot holding the time format cache of the current thread
+
+
+/**
+ * Initialize the time format caches. Called only in DLL::onProcessAttach().
+ */
+void WINAPI InitTimeFormatCache() {
+   g_timeFormatTls = TlsAlloc();
+   if (g_timeFormatTls == TLS_OUT_OF_INDEXES) error(ERR_WIN32_ERROR+GetLastError(), "TlsAlloc()");
+}
+
+
+/**
+ * Release the time format caches of all threads. Called only in DLL::onProcessDetach().
+ */
+void WINAPI ReleaseTimeFormatCache() {
+   for (uint i=0, size=g_timeFormatCaches.size(); i < size; ++i) {
+      free(g_timeFormatCaches[i]);
+   }
+   TlsFree(g_timeFormatTls);
+}
+
+
+/**
+ * Release the time format cache of the current thread. Called only in DLL::onThreadDetach() under the loader lock, so the
+ * function doesn't lock: the registry slot is cleared with an interlocked write and reused by GetTimeFormatCache().
+ */
+void WINAPI ReleaseThreadTimeFormatCache() {
+   if (g_timeFormatTls == TLS_OUT_OF_INDEXES) return;
+   TIME_FORMAT_CACHE* cache = (TIME_FORMAT_CACHE*)TlsGetValue(g_timeFormatTls);
+   if (!cache) return;
+   TlsSetValue(g_timeFormatTls, NULL);
+
+   if (cache->slot != EMPTY) {
+      InterlockedExchangePointer((void**)&g_timeFormatCaches[cache->slot], NULL);
+      InterlockedIncrement(&g_freeTimeFormatSlots);
+   }
+   free(cache);
+}
+
+
+/**
+ * Return the time format cache of the current thread. On first use the cache is created and registered.
+ *
+ * @return TIME_FORMAT_CACHE* - cache or a NULL pointer in case of errors
+ */
+TIME_FORMAT_CACHE* WINAPI GetTimeFormatCache() {
+   if (g_timeFormatTls == TLS_OUT_OF_INDEXES) return(NULL);
+   TIME_FORMAT_CACHE* cache = (TIME_FORMAT_CACHE*)TlsGetValue(g_timeFormatTls);
+
+   if (!cache) {
+      HotPath_CountAllocation();
+      cache = (TIME_FORMAT_CACHE*)calloc(1, sizeof(TIME_FORMAT_CACHE));
+      if (!cache) return(NULL);
+
+      if (!TryEnterCriticalSection(&g_terminalMutex)) {
+         debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+         EnterCriticalSection(&g_terminalMutex);
+      }
+      cache->slot = EMPTY;                                           // an unregistered cache is released on thread detach only
+      for (uint i=0, size=g_timeFormatCaches.size(); i < size && g_freeTimeFormatSlots > 0; ++i) {
+         if (g_timeFormatCaches[i]) continue;
+         InterlockedDecrement(&g_freeTimeFormatSlots);               // reuse the slot of an exited thread
+         g_timeFormatCaches[i] = cache;
+         cache->slot = i;
+         break;
+      }
+      if (cache->slot==EMPTY && !g_timeFormatCaches.full())
+         cache->slot = g_timeFormatCaches.push_back(cache);
+      LeaveCriticalSection(&g_terminalMutex);
+
+      TlsSetValue(g_timeFormatTls, cache);
+   }
+   return(cache);
+}
+
+
+/**
+ * Look up a formatted time in a cache entry. A time is formatted only once per second and format string, repeated calls for
+ * the same second (e.g. when writing log messages) copy the cached result.
+ *
+ * @param  TIME_FORMAT* cache   - cache entry of the time base (may be NULL)
+ * @param  uint64       key     - seconds identifying the time
+ * @param  char*        buffer  - target buffer to receive the resulting string
+ * @param  size_t       bufSize - buffer size
+ * @param  char*        format  - format control string as supported by strftime()
+ *
+ * @return size_t - number of characters copied to the target buffer or 0 if the time is not cached
+ */
+size_t WINAPI LookupTimeFormat(const TIME_FORMAT* cache, uint64 key, char* buffer, size_t bufSize, const char* format) {
+   if (!cache || !cache->length || cache->key!=key || cache->length >= bufSize) return(0);
+   if (strcmp(cache->format, format))                                           return(0);
+
+   memcpy(buffer, cache->text, cache->length+1);
+   return(cache->length);
+}
+
+
+/**
+ * Format a time and store the result in a cache entry.
+ *
+ * @param  TIME_FORMAT* cache   - cache entry of the time base (may be NULL)
+ * @param  uint64       key     - seconds identifying the time
+ * @param  tm*          tt      - broken-down time
+ * @param  char*        buffer  - target buffer to receive the resulting string
+ * @param  size_t       bufSize - buffer size
+ * @param  char*        format  - format control string as supported by strftime()
+ *
+ * @return size_t - number of characters copied to the target buffer or 0 in case of errors
+ */
+size_t WINAPI StoreTimeFormat(TIME_FORMAT* cache, uint64 key, const tm* tt, char* buffer, size_t bufSize, const char* format) {
+   size_t length = strftime(buffer, bufSize, format, tt);
+
+   if (cache && length && length < sizeof(cache->text) && strlen(format) < sizeof(cache->format)) {
+      cache->key    = key;
+      cache->length = length;
+      strcpy(cache->format, format);
+      memcpy(cache->text, buffer, length+1);
+   }
+   return(length);
+}
+
+
 /**
  * Return the system's current GMT time (also in Strategy Tester).
  *
@@ -44,7 +186,12 @@ size_t WINAPI gmtimeFormat(char* buffer, size_t bufSize, datetime timestamp, con
    if (timestamp == NaT) return(error(ERR_INVALID_PARAMETER, "invalid parameter timestamp: Not-a-Time"));
    if (timestamp < 0)    return(error(ERR_INVALID_PARAMETER, "invalid parameter timestamp: %d (negative)", timestamp));
 
-   return(strftime(buffer, bufSize, format, gmtime(&timestamp)));
+   TIME_FORMAT_CACHE* cache = GetTimeFormatCache();
+   TIME_FORMAT* entry = cache ? &cache->gmtime : NULL;
+
+   size_t length = LookupTimeFormat(entry, timestamp, buffer, bufSize, format);
+   if (!length) length = StoreTimeFormat(entry, timestamp, gmtime(&timestamp), buffer, bufSize, format);
+   return(length);
 }
 
 
@@ -69,7 +216,7 @@ const char* WINAPI GmtTimeFormatA(datetime timestamp, const char* format) {
    for (;;) {
       size <<= 1;
       buffer = (char*)alloca(size);                                  // on the stack
-      if (strftime(buffer, size, format, gmtime(&timestamp)))
+      if (gmtimeFormat(buffer, size, timestamp, format))
          break;
    }
    return(strdup(buffer));                                           // TODO: add to GC (close memory leak)
@@ -94,7 +241,12 @@ size_t WINAPI localtimeFormat(char* buffer, size_t bufSize, datetime timestamp,
    if (timestamp == NaT) return(error(ERR_INVALID_PARAMETER, "invalid parameter timestamp: Not-a-Time"));
    if (timestamp < 0)    return(error(ERR_INVALID_PARAMETER, "invalid parameter timestamp: %d (negative)", timestamp));
 
-   return(strftime(buffer, bufSize, format, localtime(&timestamp)));
+   TIME_FORMAT_CACHE* cache = GetTimeFormatCache();
+   TIME_FORMAT* entry = cache ? &cache->localtime : NULL;
+
+   size_t length = LookupTimeFormat(entry, timestamp, buffer, bufSize, format);
+   if (!length) length = StoreTimeFormat(entry, timestamp, localtime(&timestamp), buffer, bufSize, format);
+   return(length);
 }
 
 
@@ -112,6 +264,13 @@ size_t WINAPI localtimeFormat(char* buffer, size_t bufSize, datetime timestamp,
  * @see  ms-help://MS.VSCC.v90/MS.MSDNQTR.v90.en/dv_vccrt/html/6330ff20-4729-4c4a-82af-932915d893ea.htm
  */
 size_t WINAPI localtimeFormat(char* buffer, size_t bufSize, SYSTEMTIME st, const char* format) {
+   TIME_FORMAT_CACHE* cache = GetTimeFormatCache();
+   TIME_FORMAT* entry = cache ? &cache->systemtime : NULL;
+   uint64 key = ((((((uint64)st.wYear*100 + st.wMonth)*100 + st.wDay)*100 + st.wHour)*100 + st.wMinute)*100 + st.wSecond);
+
+   size_t length = LookupTimeFormat(entry, key, buffer, bufSize, format);
+   if (length) return(length);
+
    tm tt = {};
    tt.tm_year  = st.wYear - 1900;                     // years since 1900
    tt.tm_mon   = st.wMonth - 1;                       // months since January:   0..11
@@ -120,7 +279,7 @@ size_t WINAPI localtimeFormat(char* buffer, size_t bufSize, SYSTEMTIME st, const
    tt.tm_min   = st.wMinute;                          // minutes of the hour:    0..59
    tt.tm_sec   = st.wSecond;                          // seconds of the minute:  0..59
    tt.tm_isdst = -1;                                  // let the CRT compute whether DST is in effect
-   return(strftime(buffer, bufSize, format, &tt));
+   return(StoreTimeFormat(entry, key, &tt, buffer, bufSize, format));
 }
 
 
@@ -145,7 +304,7 @@ const char* WINAPI LocalTimeFormatA(datetime timestamp, const char* format) {
    for (;;) {
       size <<= 1;
       buffer = (char*)alloca(size);                                  // on the stack
-      if (strftime(buffer, size, format, localtime(&timestamp)))
+      if (localtimeFormat(buffer, size, timestamp, format))
          break;
    }
    return(strdup(buffer));                                           // TODO: add to GC (close memory leak)
@@ -0,0 +1,176 @@
+#include "expander.h"
+#include "lib/debugchannel.h"
+
+#include <algorithm>
+
+
+volatile LONG        g_debugSinks = DEBUG_SINK_CHANNEL;     // active debug output sinks
+HANDLE               g_debugChannelMapping;                 // the shared memory section
+DEBUGCHANNEL_HEADER* g_debugChannel;                        // the mapped section (NULL: the channel is not available)
+DEBUGCHANNEL_SLOT*   g_debugChannelSlots;                   // the ring slots
+
+
+/**
+ * Create the debug channel of the process. If the channel can't be created debug output goes to the debugger. Called only
+ * in DLL::onProcessAttach().
+ */
+void WINAPI InitDebugChannel() {
+   char name[64];
+   sprintf(name, DEBUGCHANNEL_NAME, GetCurrentProcessId());
+   uint size = DEBUGCHANNEL_HEADER_SIZE + DEBUGCHANNEL_SLOTS * sizeof(DEBUGCHANNEL_SLOT);
+
+   g_debugChannelMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, size, name);
+   BOOL exists = (GetLastError() == ERROR_ALREADY_EXISTS);           // another copy of the DLL in the same process
+   if (g_debugChannelMapping) {
+      g_debugChannel = (DEBUGCHANNEL_HEADER*)MapViewOfFile(g_debugChannelMapping, FILE_MAP_WRITE, 0, 0, 0);
+   }
+   if (!g_debugChannel) {
+      InterlockedExchange(&g_debugSinks, DEBUG_SINK_DEBUGGER);
+      error(ERR_WIN32_ERROR+GetLastError(), "cannot create debug channel \"%s\", using OutputDebugString()", name);
+      return;
+   }
+   g_debugChannelSlots = (DEBUGCHANNEL_SLOT*)((char*)g_debugChannel + DEBUGCHANNEL_HEADER_SIZE);
+
+   if (!exists) {                                                    // the section is zero-initialized
+      memcpy(g_debugChannel->magic, "RSFDBG", 7);
+      g_debugChannel->slots     = DEBUGCHANNEL_SLOTS;
+      g_debugChannel->slotSize  = DEBUGCHANNEL_SLOT_SIZE;
+      g_debugChannel->processId = GetCurrentProcessId();
+   }
+}
+
+
+/**
+ * Release the debug channel. Following debug output goes to the debugger. Called only in DLL::onProcessDetach().
+ */
+void WINAPI ReleaseDebugChannel() {
+   DEBUGCHANNEL_HEADER* channel = g_debugChannel;
+   g_debugChannel = NULL;
+   if (channel)               UnmapViewOfFile(channel);
+   if (g_debugChannelMapping) CloseHandle(g_debugChannelMapping);
+   g_debugChannelMapping = NULL;
+}
+
+
+/**
+ * Claim the next slot of the ring for writing a message. Never blocks: if the ring is full the oldest message is overwritten.
+ * A claimed slot must be published with DebugChannel_Commit().
+ *
+ * @param  LONG &sequence - variable receiving the sequence number of the message
+ *
+ * @return DEBUGCHANNEL_SLOT* - the slot or NULL if the channel is not available
+ */
+DEBUGCHANNEL_SLOT* WINAPI DebugChannel_Claim(LONG &sequence) {
+   DEBUGCHANNEL_HEADER* channel = g_debugChannel;
+   if (!channel) return(NULL);
+
+   sequence = InterlockedIncrement(&channel->sequence) - 1;
+   DEBUGCHANNEL_SLOT* slot = &g_debugChannelSlots[sequence & (DEBUGCHANNEL_SLOTS-1)];
+   InterlockedExchange(&slot->sequence, 0);                          // mark the slot as being written
+   return(slot);
+}
+
+
+/**
+ * Publish a message written to a claimed slot.
+ *
+ * @param  DEBUGCHANNEL_SLOT* slot
+ * @param  LONG               sequence - sequence number of the message as returned by DebugChannel_Claim()
+ * @param  uint               length   - message length
+ */
+void WINAPI DebugChannel_Commit(DEBUGCHANNEL_SLOT* slot, LONG sequence, uint length) {
+   slot->length = length;
+   InterlockedExchange(&slot->sequence, sequence + 1);               // full barrier: the text is visible before the sequence
+}
+
+
+/**
+ * Set the active debug output sinks. Affects DLL debug output only, not MQL logging.
+ *
+ * @param  int sinks - combination of DEBUG_SINK_CHANNEL and DEBUG_SINK_DEBUGGER (0: no debug output)
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI SetDebugSinks(int sinks) {
+   if (sinks & ~(DEBUG_SINK_CHANNEL|DEBUG_SINK_DEBUGGER)) return(error(ERR_INVALID_PARAMETER, "invalid parameter sinks: %d (not a combination of debug sinks)", sinks));
+
+   InterlockedExchange(&g_debugSinks, sinks);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Reader of the debug channel of a terminal. Opens a console window and prints all messages written to the channel. Meant
+ * to be started with rundll32:
+ *
+ *   rundll32 rsfMT4Expander.dll,DebugChannel_Tail <terminal-process-id>
+ *
+ * The reader never slows down writers. If it falls behind by more than the ring size the overwritten messages are reported
+ * as lost.
+ *
+ * @param  HWND      hWnd      - unused
+ * @param  HINSTANCE hInstance - unused
+ * @param  char*     cmdLine   - process id of the terminal
+ * @param  int       cmdShow   - unused
+ */
+void CALLBACK DebugChannel_Tail(HWND hWnd, HINSTANCE hInstance, char* cmdLine, int cmdShow) {
+   DWORD processId = cmdLine ? strtoul(cmdLine, NULL, 10) : 0;
+   if (!processId) {
+      MessageBoxA(NULL, "usage: rundll32 rsfMT4Expander.dll,DebugChannel_Tail <terminal-process-id>", "DebugChannel_Tail", MB_OK|MB_ICONINFORMATION);
+      return;
+   }
+   AllocConsole();
+   HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+   char name[64], text[DEBUGCHANNEL_SLOT_SIZE+32];
+   DWORD written;
+   sprintf(name, DEBUGCHANNEL_NAME, processId);
+
+   HANDLE hMapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+   if (!hMapping) {
+      uint length = sprintf(text, "waiting for the debug channel of process %d...\r\n", processId);
+      WriteFile(hConsole, text, length, &written, NULL);
+      while (!(hMapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name))) Sleep(500);
+   }
+   const DEBUGCHANNEL_HEADER* channel = (const DEBUGCHANNEL_HEADER*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+   if (!channel || memcmp(channel->magic, "RSFDBG", 7) || channel->slotSize != DEBUGCHANNEL_SLOT_SIZE) {
+      MessageBoxA(NULL, "incompatible debug channel", "DebugChannel_Tail", MB_OK|MB_ICONERROR);
+      return;
+   }
+   const DEBUGCHANNEL_SLOT* slots = (const DEBUGCHANNEL_SLOT*)((const char*)channel + DEBUGCHANNEL_HEADER_SIZE);
+   LONG ringSize = channel->slots;
+   LONG next = channel->sequence;
+   next = (next > ringSize) ? next-ringSize : 0;                     // start with the messages still in the ring
+   uint retries = 0;
+
+   while (true) {
+      LONG claimed = channel->sequence;
+      if (claimed-next > ringSize) {
+         uint length = sprintf(text, "(%d messages lost)\r\n", claimed-next-ringSize);
+         WriteFile(hConsole, text, length, &written, NULL);
+         next = claimed - ringSize;
+      }
+      while (next != claimed) {
+         const DEBUGCHANNEL_SLOT &slot = slots[next & (ringSize-1)];
+         LONG sequence = slot.sequence;
+         if (sequence != next+1) {
+            if (sequence-(next+1) < 0 && ++retries < 20) break;      // the slot is being written: retry with the next poll
+            next++;                                                  // overwritten or abandoned by its writer
+            retries = 0;
+            continue;
+         }
+         uint length = std::min(slot.length, (uint)sizeof(slot.text)-1);
+         memcpy(text, slot.text, length);
+         MemoryBarrier();
+         if (slot.sequence == next+1) {                              // the slot was not overwritten while copying
+            text[length++] = '\r';
+            text[length++] = '\n';
+            WriteFile(hConsole, text, length, &written, NULL);
+         }
+         next++;
+         retries = 0;
+      }
+      Sleep(20);
+   }
+   #pragma EXPANDER_EXPORT
+}
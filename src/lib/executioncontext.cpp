@@ -1,28 +1,41 @@
+#define DIAG_MODULE DIAG_EXECUTIONCONTEXT
 #include "expander.h"
 #include "lib/conversion.h"
 #include "lib/executioncontext.h"
 #include "lib/datetime.h"
 #include "lib/helper.h"
+#include "lib/journal.h"
+#include "lib/log.h"
+#include "lib/logwriter.h"
 #include "lib/math.h"
+#include "lib/memory.h"
+#include "lib/profiler.h"
 #include "lib/string.h"
 #include "lib/terminal.h"
 #include "lib/tester.h"
 #include "lib/timeseries.h"
+#include "lib/trigger.h"
+#include "lib/container/SegmentedVector.h"
 #include "struct/rsf/ExecutionContext.h"
 #include "struct/rsf/Order.h"
 #include "struct/rsf/Test.h"
 
 #include <fstream>
+#include <map>
 #include <math.h>
+#include <set>
 #include <time.h>
 #include <vector>
 
 
-MqlProgramList     g_mqlPrograms(1);               // all MQL programs: index 0 is not a valid pid and is always empty
-std::vector<DWORD> g_threads;                      // all known threads executing MQL programs
-std::vector<uint>  g_threadsPrograms;              // pid of the last MQL program executed by a thread
-uint               g_lastUIThreadProgram;          // pid of the last MQL program executed by the UI thread
-CRITICAL_SECTION   g_terminalMutex;                // mutex for application-wide locking
+MqlProgramList         g_mqlPrograms(1);           // all MQL programs: index 0 is not a valid pid and is always empty
+SegmentedVector<DWORD> g_threads;                  // all known threads executing MQL programs
+SegmentedVector<uint>  g_threadsPrograms;          // pid of the last MQL program executed by a thread (0: none or finished)
+SegmentedVector<LONG>  g_threadsEpochs;            // program generation seen by a thread when it last entered a program
+volatile LONG          g_freeThreadSlots;          // number of slots of exited threads available for reuse
+DWORD                  g_threadIndexTls = TLS_OUT_OF_INDEXES;    // TLS slot caching the current thread's index + 1
+uint                   g_lastUIThreadProgram;      // pid of the last MQL program executed by the UI thread
+CRITICAL_SECTION       g_terminalMutex;            // mutex for application-wide locking
 
 
 struct RECOMPILED_MODULE {                         // A struct holding the last MQL module with UninitReason UR_RECOMPILE.
@@ -32,6 +45,70 @@ struct RECOMPILED_MODULE {                         // A struct holding the last
 } g_recompiledModule;
 
 
+struct PROGRAM_CACHE {                             // Data attached to a program by MQL. Survives init cycles and is dropped
+   string              symbol;                     // on a symbol change.
+   std::vector<double> values;
+};
+
+
+struct PROGRAM_STATE {                             // DLL-side state shared by all modules of an MQL program. Holds the log
+                                                   // configuration last propagated to the program's context chain.
+   uint           syncedChainSize;                 // chain size at the last propagation
+   LONG           retiredGeneration;               // generation the program was retired in (0: the program is alive)
+   int            loglevel;
+   int            loglevelTerminal;
+   int            loglevelAlert;
+   int            loglevelDebugger;
+   int            loglevelFile;
+   int            loglevelMail;
+   int            loglevelSMS;
+   LogFile*       logger;
+   char           logFilename[MAX_PATH];
+   LogFilter      logFilter;                       // repeat suppression and rate limits of the program's log messages
+   TRIGGER_BOOK*  triggerBook;                     // the program's trigger book (NULL: no levels registered)
+
+   uint           digits;                          // symbol values derived at the last init: recalculated only if the
+   double         point;                           // symbol properties change, not in every init cycle
+   uint           pipDigits;
+   double         pip;
+   uint           pipPoints;
+   const char*    priceFormat;
+   const char*    pipPriceFormat;
+   const char*    subPipPriceFormat;
+
+   std::map<string, PROGRAM_CACHE> caches;         // caches attached by the program, see Program_StoreCache()
+};
+SegmentedVector<PROGRAM_STATE*, 1024, 1024> g_programStates(1);   // per-program state: index = program id (index 0 is always empty)
+
+
+struct LIMBO_KEY {                                 // Look-up key of unloaded programs waiting for a reload ("limbo").
+   ModuleType type;                                // Each program is indexed twice: with its chart and with hChart=NULL
+   string     name;                                // (any chart) for look-ups in tester.
+   HWND       hChart;
+
+   bool operator< (const LIMBO_KEY &other) const {
+      if (type   != other.type)   return(type   < other.type);
+      if (hChart != other.hChart) return(hChart < other.hChart);
+      return(name < other.name);
+   }
+};
+typedef std::map<LIMBO_KEY, std::set<uint> > LimboIndex;
+
+LimboIndex                g_limbo;                 // unloaded programs by look-up key (pids in ascending order)
+std::map<uint, LIMBO_KEY> g_limboPrograms;         // look-up key of each indexed program (with its chart)
+
+
+struct RETIRED_PROGRAM {                           // A finished program waiting for reclamation. The program's slot in
+   uint          pid;                              // g_mqlPrograms points to g_reclaimedChain, the original chain is kept
+   ContextChain* chain;                            // until no thread can access it anymore.
+   LONG          generation;
+};
+std::vector<RETIRED_PROGRAM> g_retiredPrograms;    // retired programs waiting for reclamation
+volatile LONG                g_programGeneration;  // reclamation generation, incremented with each retired program
+EXECUTION_CONTEXT            g_reclaimedMaster;    // placeholder master context of all reclaimed programs
+ContextChain                 g_reclaimedChain;     // placeholder chain of all reclaimed programs: {g_reclaimedMaster, NULL}
+
+
 /**
  * Core function call order of multiple tests with VisualMode=on
  * =============================================================
@@ -322,6 +399,7 @@ struct RECOMPILED_MODULE {                         // A struct holding the last
  * @see additional notes at the top of this file
  */
 int WINAPI SyncMainContext_init(EXECUTION_CONTEXT* ec, ProgramType programType, const char* programName, UninitializeReason uninitReason, DWORD initFlags, DWORD deinitFlags, const char* symbol, uint timeframe, uint digits, double point, BOOL extReporting, BOOL recordEquity, BOOL isTesting, BOOL isVisualMode, BOOL isOptimization, EXECUTION_CONTEXT* sec, HWND hChart, int droppedOnChart, int droppedOnPosX, int droppedOnPosY) {
+   LatencyProbe probe(PROBE_SYNCMAINCONTEXT_INIT);                   // measure the DLL latency of the call
    if ((uint)ec          < MIN_VALID_POINTER)          return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
    if ((uint)programName < MIN_VALID_POINTER)          return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid parameter programName: 0x%p (not a valid pointer)", programName)));
    if (strlen(programName) >= sizeof(ec->programName)) return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "illegal length of parameter programName: \"%s\" (max %d characters)", programName, sizeof(ec->programName)-1)));
@@ -330,6 +408,7 @@ int WINAPI SyncMainContext_init(EXECUTION_CONTEXT* ec, ProgramType programType,
    if ((int)timeframe <= 0)                            return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid parameter timeframe: %d", (int)timeframe)));
    if ((int)digits    <  0)                            return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid parameter digits: %d", (int)digits)));
    if (sec && (uint)sec  < MIN_VALID_POINTER)          return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid parameter sec: 0x%p (not a valid pointer)", sec)));
+   Journal_Record(JOURNAL_SYNCMAINCONTEXT_INIT, ec, programName, uninitReason); // record the lifecycle transition
    //debug("  %p  %-13s  %-14s  ec=%s", ec, programName, UninitializeReasonToStr(uninitReason), EXECUTION_CONTEXT_toStr(ec));
    if (ec->pid) SetLastThreadProgram(ec->pid);                             // set the thread's currently executed program asap (error handling)
 
@@ -383,12 +462,18 @@ int WINAPI SyncMainContext_init(EXECUTION_CONTEXT* ec, ProgramType programType,
             // create a new context chain                                  // TODO: on IR_PROGRAM_AFTERTEST somewhere exists a used context
             master  = new EXECUTION_CONTEXT();                             // create new master context
             *master = *ec;                                                 // copy main to master context
+            master->logger = NULL;                                         // the logfile reference is acquired on log config sync
             ContextChain* chain = new ContextChain();
             chain->reserve(8);
             chain->push_back(master);                                      // store master and main context in a new context chain
             chain->push_back(ec);
 
             currentPid = PushProgram(chain);                               // store the chain and update master and main context
+            if (currentPid == EMPTY) {
+               delete chain;
+               delete master;
+               return(ERR_RUNTIME_ERROR);
+            }
             master->pid = ec->pid = currentPid;
             SetLastThreadProgram(currentPid);
          }
@@ -399,6 +484,7 @@ int WINAPI SyncMainContext_init(EXECUTION_CONTEXT* ec, ProgramType programType,
       master = (*g_mqlPrograms[currentPid])[0];
       (*g_mqlPrograms[currentPid])[1] = ec;                                // store main context at old (possibly empty) position
    }
+   Limbo_Remove(currentPid);                                               // the program is (re-)loaded and leaves the limbo
 
 
    // (2) update main and master context
@@ -434,16 +520,27 @@ int WINAPI SyncMainContext_init(EXECUTION_CONTEXT* ec, ProgramType programType,
    else {}                                                                 // all values NULL or kept from the previous tick
    master->cycleTicks = ec->cycleTicks = 0;
 
+   PROGRAM_STATE &state = *g_programStates[currentPid];                   // symbol values are kept across init cycles
+   if (!state.priceFormat || digits != state.digits || point != state.point) {
+      state.digits            = digits;
+      state.point             = point;
+      state.pipDigits         = digits & (~1);
+      state.pip               = round(1./pow(10., (int)state.pipDigits), state.pipDigits);
+      state.pipPoints         = (uint)round(pow(10., (int)(digits & 1)));
+      state.pipPriceFormat    = strformat(".%d", state.pipDigits);
+      state.subPipPriceFormat = strformat("%s'", state.pipPriceFormat);
+      state.priceFormat       = (digits==state.pipDigits) ? state.pipPriceFormat : state.subPipPriceFormat;
+   }
    ec_SetDigits              (ec, digits);                                 // TODO: fix terminal bug
-   ec_SetPipDigits           (ec, digits & (~1));
-   ec_SetSubPipDigits        (ec, ec->pipDigits + 1);
-   ec_SetPip                 (ec, round(1./pow(10., (int)ec->pipDigits), ec->pipDigits));
+   ec_SetPipDigits           (ec, state.pipDigits);
+   ec_SetSubPipDigits        (ec, state.pipDigits + 1);
+   ec_SetPip                 (ec, state.pip);
    ec_SetPoint               (ec, point);
-   ec_SetPipPoints           (ec, (uint)round(pow(10., (int)(digits & 1))));
+   ec_SetPipPoints           (ec, state.pipPoints);
 
-   master->pipPriceFormat    = ec->pipPriceFormat    = strformat(".%d", ec->pipDigits);
-   master->subPipPriceFormat = ec->subPipPriceFormat = strformat("%s'", ec->pipPriceFormat);
-   master->priceFormat       = ec->priceFormat       = (ec->digits==ec->pipDigits) ? ec->pipPriceFormat : ec->subPipPriceFormat;
+   master->pipPriceFormat    = ec->pipPriceFormat    = state.pipPriceFormat;
+   master->subPipPriceFormat = ec->subPipPriceFormat = state.subPipPriceFormat;
+   master->priceFormat       = ec->priceFormat       = state.priceFormat;
 
    ec_SetSuperContext        (ec, sec);
    ec_SetThreadId            (ec, GetCurrentThreadId());
@@ -495,6 +592,9 @@ int WINAPI SyncMainContext_init(EXECUTION_CONTEXT* ec, ProgramType programType,
    }
 
    //debug("  %p  %-13s  %-14s  ec=%s", ec, programName, UninitializeReasonToStr(uninitReason), EXECUTION_CONTEXT_toStr(ec));
+   Journal_Record(JOURNAL_SYNCMAINCONTEXT_INITED, ec);                // record the resolved program
+
+   Program_Reclaim();                                                // programs retired while other threads were busy
    return(NO_ERROR);
    #pragma EXPANDER_EXPORT
 }
@@ -515,9 +615,12 @@ int WINAPI SyncMainContext_init(EXECUTION_CONTEXT* ec, ProgramType programType,
  * @see    additional notes at the top of this file
  */
 int WINAPI SyncMainContext_start(EXECUTION_CONTEXT* ec, const void* rates, int bars, int changedBars, uint ticks, datetime tickTime, double bid, double ask) {
+   LatencyProbe probe(PROBE_SYNCMAINCONTEXT_START);                  // measure the DLL latency of the call
+   HotPath hotPath;                                                  // no heap allocations in steady state
    if ((uint)ec < MIN_VALID_POINTER) return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
    if (!ec->pid)                     return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid execution context (ec.pid=0):  thread=%d  %s  ec=%s", GetCurrentThreadId(), (IsUIThread() ? "(UI)":"(non-UI)"), EXECUTION_CONTEXT_toStr(ec))));
    SetLastThreadProgram(ec->pid);                                    // set the thread's currently executed program asap (error handling)
+   if (Program_IsRetired(ec->pid))   return(_int(ERR_ILLEGAL_STATE, error(ERR_ILLEGAL_STATE, "access to retired program (pid=%d):  ec=%s", ec->pid, EXECUTION_CONTEXT_toStr(ec))));
 
    int      unchangedBars = changedBars==-1 ? -1 : bars-changedBars;
    uint     cycleTicks    = ec->cycleTicks + 1;
@@ -528,6 +631,9 @@ int WINAPI SyncMainContext_start(EXECUTION_CONTEXT* ec, const void* rates, int b
    uint chainSize = chain.size();
    EXECUTION_CONTEXT* ctx;
 
+   // propagate the log configuration only if it changed (configurable at runtime)
+   SyncLogConfig(ec, chain);
+
    // update variable values in all loaded modules
    for (uint i=0; i < chainSize; ++i) {
       if (ctx = chain[i]) {
@@ -544,16 +650,6 @@ int WINAPI SyncMainContext_start(EXECUTION_CONTEXT* ec, const void* rates, int b
          ctx->ask                 = ask;
          ctx->threadId            = threadId;
 
-         ctx->loglevel            = ec->loglevel;                    // configurable at runtime
-         ctx->loglevelTerminal    = ec->loglevelTerminal;
-         ctx->loglevelAlert       = ec->loglevelAlert;
-         ctx->loglevelDebugger    = ec->loglevelDebugger;
-         ctx->loglevelFile        = ec->loglevelFile;
-         ctx->loglevelMail        = ec->loglevelMail;
-         ctx->loglevelSMS         = ec->loglevelSMS;
-         ctx->logger              = ec->logger;
-         strcpy(ctx->logFilename, ec->logFilename);
-
          if (i < 2) {
             ctx->moduleCoreFunction = ctx->programCoreFunction;      // in master and main context only
          }
@@ -586,12 +682,20 @@ int WINAPI SyncMainContext_start(EXECUTION_CONTEXT* ec, const void* rates, int b
          }
          for (OrderList::iterator it=positions->begin(), end=positions->end(); it!=end; ++it) {
             ORDER* order = *it;
-            if (high > order->high) order->high = high;
-            if (low  < order->low ) order->low  = low;               // explicite check for max. performance
+            if (high > order->high) { order->high = high; order->highTime = tickTime; }
+            if (low  < order->low ) { order->low  = low;  order->lowTime  = tickTime; }   // explicite checks for max. performance
+
+            // retracement from the favorable extreme (in BarOpen mode the order of bar high and low is unknown, the bar's
+            // full range is used)
+            double retrace = (order->type == OP_LONG) ? order->high - low : high - order->low;
+            if (retrace > order->retrace) order->retrace = retrace;
          }
       }
    }
 
+   // collect the triggered stop and limit levels of the program
+   Trigger_onTick(ec->pid, bid, ask, ec->point);
+
    //if (ec->cycleTicks == 1) debug(" %p  %-13s  %-14s  ec=%s", ec, ec->programName, "", EXECUTION_CONTEXT_toStr(ec));
    return(NO_ERROR);
    #pragma EXPANDER_EXPORT
@@ -612,10 +716,13 @@ int WINAPI SyncMainContext_start(EXECUTION_CONTEXT* ec, const void* rates, int b
  * @see  additional notes at the top of this file
  */
 int WINAPI SyncMainContext_deinit(EXECUTION_CONTEXT* ec, UninitializeReason uninitReason) {
+   LatencyProbe probe(PROBE_SYNCMAINCONTEXT_DEINIT);                 // measure the DLL latency of the call
    if ((uint)ec < MIN_VALID_POINTER) return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
    if (!ec->pid)                     return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid execution context (ec.pid=0):  uninitReason=%s  thread=%d %s  ec=%s", UninitializeReasonToStr(uninitReason), GetCurrentThreadId(), (IsUIThread() ? "(UI)":"(non-UI)"), EXECUTION_CONTEXT_toStr(ec))));
+   Journal_Record(JOURNAL_SYNCMAINCONTEXT_DEINIT, ec, NULL, uninitReason); // record the lifecycle transition
    //debug("%p  %-13s  %-14s  ec=%s", ec, ec->programName, UninitializeReasonToStr(uninitReason), EXECUTION_CONTEXT_toStr(ec));
    SetLastThreadProgram(ec->pid);                                    // set the thread's currently executed program asap (error handling)
+   if (Program_IsRetired(ec->pid))   return(_int(ERR_ILLEGAL_STATE, error(ERR_ILLEGAL_STATE, "access to retired program (pid=%d):  ec=%s", ec->pid, EXECUTION_CONTEXT_toStr(ec))));
 
    ContextChain &chain = *g_mqlPrograms[ec->pid];
    uint chainSize = chain.size();
@@ -636,7 +743,8 @@ int WINAPI SyncMainContext_deinit(EXECUTION_CONTEXT* ec, UninitializeReason unin
          ctx->loglevelFile        = ec->loglevelFile;
          ctx->loglevelMail        = ec->loglevelMail;
          ctx->loglevelSMS         = ec->loglevelSMS;
-         ctx->logger              = ec->logger;
+         if (i) ctx->logger       = ec->logger;
+         else   Program_SetLogger(ctx, ec->logger);                  // the master context holds a reference
          strcpy(ctx->logFilename, ec->logFilename);
 
          if (i < 2) {                                                // in master and main context only
@@ -674,6 +782,7 @@ int WINAPI SyncMainContext_deinit(EXECUTION_CONTEXT* ec, UninitializeReason unin
  * @see    additional notes at the top of this file
  */
 int WINAPI SyncLibContext_init(EXECUTION_CONTEXT* ec, UninitializeReason uninitReason, DWORD initFlags, DWORD deinitFlags, const char* moduleName, const char* symbol, uint timeframe, uint digits, double point, BOOL isTesting, BOOL isOptimization) {
+   LatencyProbe probe(PROBE_SYNCLIBCONTEXT_INIT);                    // measure the DLL latency of the call
    if ((uint)ec         < MIN_VALID_POINTER)         return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
    if ((uint)moduleName < MIN_VALID_POINTER)         return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid parameter moduleName: 0x%p (not a valid pointer)", moduleName)));
    if (strlen(moduleName) >= sizeof(ec->moduleName)) return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "illegal length of parameter moduleName: \"%s\" (max %d characters)", moduleName, sizeof(ec->moduleName)-1)));
@@ -682,6 +791,7 @@ int WINAPI SyncLibContext_init(EXECUTION_CONTEXT* ec, UninitializeReason uninitR
    if ((int)timeframe <= 0)                          return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid parameter timeframe: %d", (int)timeframe)));
    if ((int)digits < 0)                              return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid parameter digits: %d", (int)digits)));
    if (point <= 0)                                   return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid parameter point: %f", point)));
+   Journal_Record(JOURNAL_SYNCLIBCONTEXT_INIT, ec, moduleName, uninitReason); // record the lifecycle transition
    //debug("   %p  %-13s  %-14s  ec=%s", ec, moduleName, UninitializeReasonToStr(uninitReason), EXECUTION_CONTEXT_toStr(ec));
 
    // fix the UninitializeReason
@@ -751,7 +861,12 @@ int WINAPI SyncLibContext_init(EXECUTION_CONTEXT* ec, UninitializeReason uninitR
                chain->push_back(master);                             // add master to a new chain
                chain->push_back(NULL);                               // add empty entry for the yet to come main context
                currentPid = PushProgram(chain);                      // store the chain
-               uint threadIndex = SetLastThreadProgram(currentPid);
+               if (currentPid == EMPTY) {
+                  delete chain;
+                  delete master;
+                  return(ERR_RUNTIME_ERROR);
+               }
+               SetLastThreadProgram(currentPid);
 
                master->pid          = currentPid;                    // update master context with the known values
                master->programType  = PT_EXPERT;
@@ -772,7 +887,7 @@ int WINAPI SyncLibContext_init(EXECUTION_CONTEXT* ec, UninitializeReason uninitR
                master->priceFormat       = (master->digits==master->pipDigits) ? master->pipPriceFormat : master->subPipPriceFormat;
 
                master->superContext = FALSE;
-               master->threadId     = g_threads[threadIndex];
+               master->threadId     = GetCurrentThreadId();
 
                master->testing      = TRUE;                          // TODO: so wrong, we can be online and not in tester
                master->optimization = isOptimization;
@@ -819,6 +934,7 @@ int WINAPI SyncLibContext_init(EXECUTION_CONTEXT* ec, UninitializeReason uninitR
       // (2.1) ec.pid is set: indicator in init cycle or in IR_PROGRAM_AFTERTEST (both UI thread)
       //       ec.pid points to the original indicator (still in limbo), Library::init() is called before Indicator::init()
       SetLastThreadProgram(ec->pid);                                 // set the thread's currently executed program asap (error handling)
+      if (Program_IsRetired(ec->pid)) return(_int(ERR_ILLEGAL_STATE, error(ERR_ILLEGAL_STATE, "access to retired program (pid=%d):  ec=%s", ec->pid, EXECUTION_CONTEXT_toStr(ec))));
 
       EXECUTION_CONTEXT* master = (*g_mqlPrograms[ec->pid])[0];
       if (isTesting)                                                 // indicator in IR_PROGRAM_AFTERTEST
@@ -896,7 +1012,12 @@ int WINAPI SyncLibContext_init(EXECUTION_CONTEXT* ec, UninitializeReason uninitR
          chain->push_back(master);                                   // add master to a new chain
          chain->push_back(NULL);                                     // add empty entry for the yet to come main context
          currentPid = PushProgram(chain);                            // store the chain
-         uint threadIndex = SetLastThreadProgram(currentPid);
+         if (currentPid == EMPTY) {
+            delete chain;
+            delete master;
+            return(ERR_RUNTIME_ERROR);
+         }
+         SetLastThreadProgram(currentPid);
 
          master->pid               = currentPid;                     // update master context with the known values
          master->previousPid       = ec->pid;
@@ -922,7 +1043,7 @@ int WINAPI SyncLibContext_init(EXECUTION_CONTEXT* ec, UninitializeReason uninitR
          master->subPipPriceFormat = strformat("%s'", master->pipPriceFormat);
          master->priceFormat       = (master->digits==master->pipDigits) ? master->pipPriceFormat : master->subPipPriceFormat;
 
-         master->threadId      = g_threads[threadIndex];
+         master->threadId      = GetCurrentThreadId();
          master->testing       = TRUE;
          master->optimization  = isOptimization;
       }
@@ -943,6 +1064,7 @@ int WINAPI SyncLibContext_init(EXECUTION_CONTEXT* ec, UninitializeReason uninitR
    }
 
    //debug("   %p  %-13s  %-14s  ec=%s", ec, moduleName, UninitializeReasonToStr(uninitReason), EXECUTION_CONTEXT_toStr(ec));
+   Journal_Record(JOURNAL_SYNCLIBCONTEXT_INITED, ec);                 // record the resolved program
    return(NO_ERROR);
    #pragma EXPANDER_EXPORT
 }
@@ -960,8 +1082,10 @@ int WINAPI SyncLibContext_init(EXECUTION_CONTEXT* ec, UninitializeReason uninitR
  * @see    additional notes at the top of this file
  */
 int WINAPI SyncLibContext_deinit(EXECUTION_CONTEXT* ec, UninitializeReason uninitReason) {
+   LatencyProbe probe(PROBE_SYNCLIBCONTEXT_DEINIT);                  // measure the DLL latency of the call
    if ((uint)ec < MIN_VALID_POINTER) return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
    if (!ec->pid)                     return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid execution context (ec.pid=0):  uninitReason=%s  thread=%d (%s)  ec=%s", UninitializeReasonToStr(uninitReason), GetCurrentThreadId(), IsUIThread() ? "UI":"non-UI", EXECUTION_CONTEXT_toStr(ec))));
+   Journal_Record(JOURNAL_SYNCLIBCONTEXT_DEINIT, ec, NULL, uninitReason); // record the lifecycle transition
    //debug(" %p  %-13s  %-14s  ec=%s", ec, ec->moduleName, UninitializeReasonToStr(uninitReason), EXECUTION_CONTEXT_toStr(ec));
    SetLastThreadProgram(ec->pid);                        // set the thread's currently executed program asap (error handling)
 
@@ -1010,10 +1134,13 @@ int WINAPI SyncLibContext_deinit(EXECUTION_CONTEXT* ec, UninitializeReason unini
  *            Use the master context at chain index 0 to access data stored in the execution context of an unloaded module.
  */
 int WINAPI LeaveContext(EXECUTION_CONTEXT* ec) {
+   LatencyProbe probe(PROBE_LEAVECONTEXT);                           // measure the DLL latency of the call
    if ((uint)ec < MIN_VALID_POINTER)        return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
    if (!ec->pid)                            return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid execution context (ec.pid=0):  thread=%d (%s)  ec=%s", GetCurrentThreadId(), IsUIThread() ? "UI":"non-UI", EXECUTION_CONTEXT_toStr(ec))));
+   Journal_Record(JOURNAL_LEAVECONTEXT, ec);                          // record the lifecycle transition
    if (ec->moduleCoreFunction != CF_DEINIT) return(_int(ERR_INVALID_PARAMETER, error(ERR_INVALID_PARAMETER, "invalid execution context (ec.moduleCoreFunction not CF_DEINIT):  thread=%d (%s)  ec=%s", GetCurrentThreadId(), IsUIThread() ? "UI":"non-UI", EXECUTION_CONTEXT_toStr(ec))));
    if (g_mqlPrograms.size() <= ec->pid)     return(_int(ERR_ILLEGAL_STATE, error(ERR_ILLEGAL_STATE, "illegal list of ContextChains (size=%d) for pid=%d:  ec=%s", g_mqlPrograms.size(), ec->pid, EXECUTION_CONTEXT_toStr(ec))));
+   if (Program_IsRetired(ec->pid))          return(_int(ERR_ILLEGAL_STATE, error(ERR_ILLEGAL_STATE, "access to retired program (pid=%d):  ec=%s", ec->pid, EXECUTION_CONTEXT_toStr(ec))));
 
    ContextChain &chain = *g_mqlPrograms[ec->pid];
    uint chainSize = chain.size();
@@ -1036,6 +1163,9 @@ int WINAPI LeaveContext(EXECUTION_CONTEXT* ec) {
             else warn(ERR_ILLEGAL_STATE, "no module context found at chain[%d]: %p  main=%s", i, chain[i], EXECUTION_CONTEXT_toStr(ec));
          }
          chain[1] = NULL;                                                  // unset the main execution context but keep the slot in the chain
+
+         if (ec->moduleType==MT_INDICATOR && chain[0])                     // only indicators are looked-up for a reload
+            Limbo_Add(ec->pid, ec->moduleType, chain[0]->programName, chain[0]->hChart);
          break;
 
       // --- library module --------------------------------------------------------------------------------------------------
@@ -1065,10 +1195,19 @@ int WINAPI LeaveContext(EXECUTION_CONTEXT* ec) {
          return(_int(ERR_ILLEGAL_STATE, error(ERR_ILLEGAL_STATE, "illegal execution context (unknown ec.moduleType):  ec=%s", EXECUTION_CONTEXT_toStr(ec))));
    }
 
-   // close an open logfile
-   if (ec->logger && ec->logger->is_open())
-      ec->logger->close();                                                 // is automatically re-opened on next use
+   // write pending log filter counts and close an open logfile if no other program uses it
+   if (ec->moduleType != MT_LIBRARY) FlushLogFilter(ec);
+   if (chain[0] && chain[0]->logger) Logfile_Close(chain[0]->logger);      // is automatically re-opened on next use
 
+   // retire a finished program after all its modules have been unloaded and reclaim memory of former programs
+   if (chain.size()==2 && !chain[1] && chain[0] && Program_IsFinished(chain[0])) {
+      Program_Retire(ec->pid);
+
+      uint index = GetCurrentThreadIndex();
+      if (index != EMPTY && g_threadsPrograms[index] == ec->pid)
+         g_threadsPrograms[index] = 0;                                     // the thread is done with the program
+      Program_Reclaim();
+   }
    return(NO_ERROR);
    #pragma EXPANDER_EXPORT
 }
@@ -1102,6 +1241,10 @@ TEST* WINAPI Expert_InitTest(EXECUTION_CONTEXT* ec, BOOL isTesting) {
       test->closedLongPositions  = new OrderList(); test->closedLongPositions ->reserve(1024);
       test->closedShortPositions = new OrderList(); test->closedShortPositions->reserve(1024);
 
+      test->closedHistory         = new ORDER_HISTORY();
+      test->closedHistoryByMagic  = new OrderHistoryByMagic();
+      test->closedHistoryBySymbol = new OrderHistoryBySymbol();
+
       return(test);
    }
    return(NULL);
@@ -1109,7 +1252,64 @@ TEST* WINAPI Expert_InitTest(EXECUTION_CONTEXT* ec, BOOL isTesting) {
 
 
 /**
- * Find the first unloaded module suitable for reloading matching the specified arguments.
+ * Add an unloaded program to the index of programs waiting for a reload.
+ *
+ * @param  uint        pid    - program id
+ * @param  ModuleType  type   - the program's main module type
+ * @param  const char* name   - the program's name
+ * @param  HWND        hChart - the program's chart handle
+ */
+void WINAPI Limbo_Add(uint pid, ModuleType type, const char* name, HWND hChart) {
+   if (!TryEnterCriticalSection(&g_terminalMutex)) {
+      debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+      EnterCriticalSection(&g_terminalMutex);
+   }
+   Limbo_Remove(pid);                                             // the key may have changed since the last unload
+
+   LIMBO_KEY key = { type, name, hChart };
+   g_limboPrograms[pid] = key;
+   g_limbo[key].insert(pid);                                      // index with the program's chart
+   if (hChart) {
+      key.hChart = NULL;
+      g_limbo[key].insert(pid);                                   // index for any chart
+   }
+   LeaveCriticalSection(&g_terminalMutex);
+}
+
+
+/**
+ * Remove a program from the index of programs waiting for a reload. Does nothing if the program is not indexed.
+ *
+ * @param  uint pid - program id
+ */
+void WINAPI Limbo_Remove(uint pid) {
+   if (!TryEnterCriticalSection(&g_terminalMutex)) {
+      debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+      EnterCriticalSection(&g_terminalMutex);
+   }
+   std::map<uint, LIMBO_KEY>::iterator it = g_limboPrograms.find(pid);
+
+   if (it != g_limboPrograms.end()) {
+      LIMBO_KEY key = it->second;
+      g_limboPrograms.erase(it);
+
+      for (int i=0; i < 2; ++i) {                                 // remove both index entries
+         LimboIndex::iterator entry = g_limbo.find(key);
+         if (entry != g_limbo.end()) {
+            entry->second.erase(pid);
+            if (entry->second.empty()) g_limbo.erase(entry);
+         }
+         if (!key.hChart) break;
+         key.hChart = NULL;
+      }
+   }
+   LeaveCriticalSection(&g_terminalMutex);
+}
+
+
+/**
+ * Find the first unloaded module suitable for reloading matching the specified arguments. Indicators are looked-up in the
+ * index of unloaded programs, so the look-up doesn't depend on the number of programs loaded since terminal start.
  *
  * @param  ModuleType         type
  * @param  const char*        name
@@ -1125,64 +1325,47 @@ uint WINAPI FindModuleInLimbo(ModuleType type, const char* name, UninitializeRea
          // If the indicator was not used in a test (testing=FALSE) master.threadId must be the UI thread.
          // If the indicator was used in a test (testing=TRUE) master.threadId depends on whether one of the indicator's
          // libraries has been reloaded before.
-         uint chainsSize = g_mqlPrograms.size();
-         EXECUTION_CONTEXT* master;
+         //
+         // If not in a test a chart must exist. Possible use cases:
+         // - a regular init cycle in the UI thread
+         // - a recompilation (again in the UI thread)
+         if (!testing && !hChart) break;
 
          // TODO: In a test the hChart window is ignored - atm.
-         if (testing) {
-            for (uint i=1; i < chainsSize; ++i) {                                   // index[0] is always empty
+         LIMBO_KEY key = { type, name, testing ? NULL : hChart };
+         EXECUTION_CONTEXT* master;
+         uint pid = NULL;
+
+         if (!TryEnterCriticalSection(&g_terminalMutex)) {
+            debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+            EnterCriticalSection(&g_terminalMutex);
+         }
+         LimboIndex::iterator entry = g_limbo.find(key);
+
+         if (entry != g_limbo.end()) {
+            for (std::set<uint>::iterator it=entry->second.begin(), end=entry->second.end(); it != end; ++it) {
+               uint i = *it;
                ContextChain &chain = *g_mqlPrograms[i];
                uint size = chain.size();
-               if (size) {
-                  if (master = chain[0]) {
-                     if (master->programType == MT_INDICATOR) {
-                        if (!master->programCoreFunction) {                         // main module is unloaded
-                           if (master->programUninitReason == uninitReason) {
-                              if (StrCompare(master->programName, name)) {          // name check at the end
-                                 if (size > 2) {                                    // with libraries master->threadId must be the UI thread
-                                    if (IsUIThread(master->threadId)) {
-                                       return(i);
-                                    }
-                                 }
-                                 else if (!IsUIThread(master->threadId)) {          // without libraries master->threadId must not be the UI thread
-                                    return(i);
-                                 }
-                              }
-                           }
-                        }
-                     }
-                  } else warn(ERR_ILLEGAL_STATE, "illegal master context found in ContextChain of program %d:  master=0x%p", i, master);
-               } else warn(ERR_ILLEGAL_STATE, "illegal ContextChain found at g_mqlPrograms[%d]:  size=%d", size);
-            }
-         }
+               if (!size)             { warn(ERR_ILLEGAL_STATE, "illegal ContextChain found at g_mqlPrograms[%d]:  size=%d", i, size); continue; }
+               if (!(master=chain[0])) { warn(ERR_ILLEGAL_STATE, "illegal master context found in ContextChain of program %d:  master=0x%p", i, master); continue; }
 
-         // If not in a test a chart must exist. Possible use cases:
-         // - a regular init cycle in the UI thread
-         // - a recompilation (again in the UI thread)
-         else {
-            if (hChart) {
-               for (uint i=1; i < chainsSize; ++i) {                                // index[0] is always empty
-                  ContextChain &chain = *g_mqlPrograms[i];
-                  if (chain.size()) {
-                     if (master = chain[0]) {
-                        if (master->programType == MT_INDICATOR) {
-                           if (!master->programCoreFunction) {                      // main module is unloaded
-                              if (master->programUninitReason == uninitReason) {
-                                 if (master->hChart == hChart) {
-                                    if (IsUIThread(master->threadId)) {             // master->threadId must be the UI thread
-                                       if (StrCompare(master->programName, name)) { // name check last
-                                          return(i);
-                                       }
-                                    }
-                                 }
-                              }
-                           }
-                        }
-                     } else warn(ERR_ILLEGAL_STATE, "illegal master context found in ContextChain of program %d:  master=0x%p", i, master);
-                  } else warn(ERR_ILLEGAL_STATE, "illegal ContextChain found at g_mqlPrograms[%d]:  size=%d", chain.size());
+               if (master->programCoreFunction)                   continue;    // main module is not unloaded
+               if (master->programUninitReason != uninitReason)   continue;
+
+               if (testing) {
+                  if (size > 2) { if (!IsUIThread(master->threadId)) continue; } // with libraries master->threadId must be the UI thread
+                  else if (IsUIThread(master->threadId))             continue;    // without libraries master->threadId must not be the UI thread
                }
+               else if (!IsUIThread(master->threadId))               continue;    // master->threadId must be the UI thread
+
+               pid = i;
+               break;
             }
          }
+         LeaveCriticalSection(&g_terminalMutex);
+
+         if (pid) return(pid);
          break;
       }
 
@@ -1387,35 +1570,81 @@ UninitializeReason WINAPI FixUninitReason(EXECUTION_CONTEXT* ec, ModuleType modu
 
 /**
  * Find the index of the current thread in the list of known threads. If the current thread is not found it is added to
- * the list.
+ * the list, reusing the slot of an exited thread if possible. The index is cached in thread-local storage, so the lookup
+ * doesn't depend on the number of known threads.
+ *
+ * The function is called by the error handler and must not call error() or warn() itself.
  *
- * @return uint - thread index
+ * @return uint - thread index or EMPTY (-1) if the list of known threads is full
  */
 uint WINAPI GetCurrentThreadIndex() {
-   DWORD currentThread = GetCurrentThreadId();
+   // look-up the cached index of the current thread (stored as index+1, a thread without a value is not yet registered)
+   if (uint value = (uint)TlsGetValue(g_threadIndexTls))
+      return(value==EMPTY ? EMPTY : value-1);                    // EMPTY: an excluded thread, see ExcludeCurrentThread()
 
-   // look-up the current thread
-   uint size = g_threads.size();
-   for (uint i=0; i < size; i++) {
-      if (g_threads[i] == currentThread)                          // thread found
-         return(i);
-   }
+   // thread not yet registered
+   DWORD currentThread = GetCurrentThreadId();
+   uint index = EMPTY;
 
-   // thread not found
    if (!TryEnterCriticalSection(&g_terminalMutex)) {
-      debug("waiting to aquire lock on: g_terminalMutex");
+      debugIn(DIAG_LOCK, "waiting to aquire lock on: g_terminalMutex");
       EnterCriticalSection(&g_terminalMutex);
    }
-   g_threads        .push_back(currentThread);                    // add current thread to the list
-   g_threadsPrograms.push_back(0);                                // add empty program index of 0 (zero) to the list
-   uint index = g_threads.size() - 1;
+   if (g_freeThreadSlots > 0) {                                   // reuse the slot of an exited thread
+      for (uint i=0, size=g_threads.size(); i < size; ++i) {
+         if (g_threads[i]) continue;
+         InterlockedDecrement(&g_freeThreadSlots);
+         g_threadsPrograms[i] = 0;
+         g_threadsEpochs[i] = 0;
+         g_threads[i] = currentThread;
+         index = i;
+         break;
+      }
+   }
+   if (index==EMPTY && !g_threads.full() && !g_threadsPrograms.full() && !g_threadsEpochs.full()) {  // the lists grow in lockstep
+      g_threadsPrograms.push_back(0);                             // add empty program index of 0 (zero) to the list
+      g_threadsEpochs.push_back(0);
+      index = g_threads.push_back(currentThread);                 // add current thread to the list (publishes the entry)
+   }
    LeaveCriticalSection(&g_terminalMutex);
 
-   if (index > 768) debug("thread %d added (size=%d)", currentThread, index+1);
+   if (index == EMPTY) {
+      debug("too many threads, thread %d not registered (size=%d)", currentThread, g_threads.size());
+      return(EMPTY);                                              // not cached: the next call tries again
+   }
+   TlsSetValue(g_threadIndexTls, (void*)(index + 1));
+   if (index > 768) debug("thread %d added (size=%d)", currentThread, g_threads.size());
    return(index);
 }
 
 
+/**
+ * Remove the current thread from the list of known threads and make its slot available for reuse. Called only in
+ * DllMain(DLL_THREAD_DETACH) under the loader lock, so the function doesn't lock: the slot is released with interlocked
+ * writes and collected by GetCurrentThreadIndex().
+ */
+void WINAPI ReleaseCurrentThreadIndex() {
+   uint value = (uint)TlsGetValue(g_threadIndexTls);
+   if (!value || value==EMPTY) return;                            // the thread was never registered
+   uint index = value - 1;
+
+   InterlockedExchange((LONG*)&g_threadsPrograms[index], 0);      // the thread no longer accesses any program
+   InterlockedExchange((LONG*)&g_threads[index], 0);
+   InterlockedIncrement(&g_freeThreadSlots);
+
+   TlsSetValue(g_threadIndexTls, NULL);
+}
+
+
+/**
+ * Exclude the current thread from the list of known threads. For internal threads never executing MQL programs (e.g. the
+ * log writer): GetCurrentThreadIndex() returns EMPTY, so the error handler never enters g_terminalMutex on such a thread.
+ */
+void WINAPI ExcludeCurrentThread() {
+   TlsSetValue(g_threadIndexTls, (void*)EMPTY);
+}
+
+
 /**
  * Get the id of the last MQL program executed by the current thread.
  *
@@ -1430,17 +1659,23 @@ uint WINAPI GetLastThreadProgram() {
 
 
 /**
- * Link the specified MQL program to the current thread.
+ * Link the specified MQL program to the current thread. The thread also records the current program generation: from now on
+ * it can't access a program retired before, see Program_Reclaim().
  *
  * @param  uint pid - MQL program id
  *
- * @return int - index of the current thread in the list of known threads or EMPTY (-1) in case of errors
+ * @return int - index of the current thread in the list of known threads or EMPTY (-1) in case of errors or if the
+ *               list of known threads is full
  */
 int WINAPI SetLastThreadProgram(uint pid) {
    if ((int)pid < 1) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter pid: %d", pid)));
 
    uint index = GetCurrentThreadIndex();
-   g_threadsPrograms[index] = pid;                       // update the thread's last executed program
+   if (index != EMPTY) {
+      // publish epoch and program with a full barrier before the program is looked-up, so Program_Reclaim() sees them
+      InterlockedExchange(&g_threadsEpochs[index], g_programGeneration);
+      InterlockedExchange((LONG*)&g_threadsPrograms[index], pid);
+   }
 
    if (IsUIThread())
       g_lastUIThreadProgram = pid;                       // update lastUIThreadProgram if the thread is the UI thread
@@ -1858,21 +2093,369 @@ BOOL WINAPI Program_IsVisualMode(const EXECUTION_CONTEXT* ec, BOOL isVisualMode)
 
 
 /**
- * Push the specififed ContextChain (an MQL program) onto the end of the program list.
+ * Propagate the log configuration of a program's main module to all contexts of the program. The configuration is compared
+ * with the one last propagated and copied only if it changed, if modules were added to the chain or if the loglevels of
+ * another context differ (e.g. changed by a library via ec_SetLoglevel*()). The check of the other contexts compares only
+ * integers, so the per-tick cost stays small and bounded by the chain size.
+ *
+ * @param  EXECUTION_CONTEXT* ec    - main module context of a program
+ * @param  ContextChain&      chain - the program's context chain
+ *
+ * @return BOOL - whether the configuration was propagated
+ */
+BOOL WINAPI SyncLogConfig(const EXECUTION_CONTEXT* ec, ContextChain &chain) {
+   PROGRAM_STATE* state = (g_programStates.size() > ec->pid) ? g_programStates[ec->pid] : NULL;
+   if (!state) return(error(ERR_ILLEGAL_STATE, "no program state found for pid=%d", ec->pid));
+
+   uint chainSize = chain.size();
+
+   if (state->syncedChainSize     == chainSize
+    && state->loglevel            == ec->loglevel
+    && state->loglevelTerminal    == ec->loglevelTerminal
+    && state->loglevelAlert       == ec->loglevelAlert
+    && state->loglevelDebugger    == ec->loglevelDebugger
+    && state->loglevelFile        == ec->loglevelFile
+    && state->loglevelMail        == ec->loglevelMail
+    && state->loglevelSMS         == ec->loglevelSMS
+    && state->logger              == ec->logger
+    && StrCompare(state->logFilename, ec->logFilename)) {
+      uint i = 0;
+      for (; i < chainSize; ++i) {
+         const EXECUTION_CONTEXT* ctx = chain[i];
+         if (ctx && (ctx->loglevel         != ec->loglevel
+                  || ctx->loglevelTerminal != ec->loglevelTerminal
+                  || ctx->loglevelAlert    != ec->loglevelAlert
+                  || ctx->loglevelDebugger != ec->loglevelDebugger
+                  || ctx->loglevelFile     != ec->loglevelFile
+                  || ctx->loglevelMail     != ec->loglevelMail
+                  || ctx->loglevelSMS      != ec->loglevelSMS)) break;
+      }
+      if (i == chainSize) return(FALSE);                             // unchanged in all contexts
+   }
+
+   state->loglevel         = ec->loglevel;
+   state->loglevelTerminal = ec->loglevelTerminal;
+   state->loglevelAlert    = ec->loglevelAlert;
+   state->loglevelDebugger = ec->loglevelDebugger;
+   state->loglevelFile     = ec->loglevelFile;
+   state->loglevelMail     = ec->loglevelMail;
+   state->loglevelSMS      = ec->loglevelSMS;
+   state->logger           = ec->logger;
+   strcpy(state->logFilename, ec->logFilename);
+   state->syncedChainSize  = chainSize;
+
+   for (uint i=0; i < chainSize; ++i) {
+      if (EXECUTION_CONTEXT* ctx = chain[i]) {
+         if (ctx == ec) continue;
+         ctx->loglevel         = ec->loglevel;
+         ctx->loglevelTerminal = ec->loglevelTerminal;
+         ctx->loglevelAlert    = ec->loglevelAlert;
+         ctx->loglevelDebugger = ec->loglevelDebugger;
+         ctx->loglevelFile     = ec->loglevelFile;
+         ctx->loglevelMail     = ec->loglevelMail;
+         ctx->loglevelSMS      = ec->loglevelSMS;
+         if (i) ctx->logger    = ec->logger;
+         else   Program_SetLogger(ctx, ec->logger);                  // the master context holds a reference
+         strcpy(ctx->logFilename, ec->logFilename);
+      }
+   }
+   return(TRUE);
+}
+
+
+/**
+ * Push the specififed ContextChain (an MQL program) onto the end of the program list. The list never moves stored entries,
+ * so readers may access it without locking while a program is added.
  *
  * @param  ContextChain* chain
  *
- * @return uint - index where the program is stored
+ * @return uint - index where the program is stored or EMPTY (-1) if the program list is full
  */
 uint WINAPI PushProgram(ContextChain* chain) {
    if (!TryEnterCriticalSection(&g_terminalMutex)) {
-      debug("waiting to aquire lock on g_terminalMutex...");
+      debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
       EnterCriticalSection(&g_terminalMutex);
    }
-   g_mqlPrograms.push_back(chain);
-   uint index = g_mqlPrograms.size()-1;
+   if (g_mqlPrograms.full() || g_programStates.full()) {          // both lists grow in lockstep: neither push may fail
+      LeaveCriticalSection(&g_terminalMutex);
+      return(_EMPTY(error(ERR_RUNTIME_ERROR, "cannot register more programs (%d programs loaded since terminal start)", g_mqlPrograms.size()-1)));
+   }
+   g_programStates.push_back(new PROGRAM_STATE());                // the program's state is available before the program
+   uint index = g_mqlPrograms.push_back(chain);                   // publishes the program to lock-free readers
    LeaveCriticalSection(&g_terminalMutex);
 
    //if (index > 31) debug("registered programs: %d", index);   // index[0] is always empty
    return(index);
 }
+
+
+/**
+ * Whether a program with all modules unloaded is finished and will never be reloaded.
+ *
+ * @param  EXECUTION_CONTEXT* master - master context of the program
+ *
+ * @return BOOL
+ */
+BOOL WINAPI Program_IsFinished(const EXECUTION_CONTEXT* master) {
+   if (master->programCoreFunction) return(FALSE);                  // the main module is loaded
+
+   switch (master->programType) {
+      case PT_INDICATOR:
+         if (master->programUninitReason == UR_REMOVE)     return(TRUE);
+         if (master->programUninitReason == UR_CHARTCLOSE) return(!master->testing);    // in tester reloaded with IR_PROGRAM_AFTERTEST
+         return(FALSE);
+
+      case PT_EXPERT:
+         if (master->testing)                              return(master->programInitReason != NULL);   // each test uses a new program,
+         return(master->programUninitReason==UR_REMOVE || master->programUninitReason==UR_CHARTCLOSE);  // skip partial test chains
+
+      case PT_SCRIPT:
+         return(TRUE);                                               // scripts are never reloaded
+   }
+   return(FALSE);
+}
+
+
+/**
+ * Return the log filter of a program.
+ *
+ * @param  uint pid - program id
+ *
+ * @return LogFilter* - filter or NULL if the program doesn't exist or was reclaimed
+ */
+LogFilter* WINAPI Program_GetLogFilter(uint pid) {
+   if (pid && g_programStates.size() > pid) {
+      if (PROGRAM_STATE* state = g_programStates[pid])
+         return(&state->logFilter);
+   }
+   return(NULL);
+}
+
+
+/**
+ * Return the trigger book of a program. Lock-free, the book is owned by the trigger book registry.
+ *
+ * @param  uint pid - program id
+ *
+ * @return TRIGGER_BOOK* - book or NULL if the program has no trigger book or was reclaimed
+ */
+TRIGGER_BOOK* WINAPI Program_GetTriggerBook(uint pid) {
+   if (pid && g_programStates.size() > pid) {
+      if (const PROGRAM_STATE* state = g_programStates[pid])
+         return(state->triggerBook);
+   }
+   return(NULL);
+}
+
+
+/**
+ * Link a trigger book to a program. Must be called by the trigger book registry only, i.e. while holding g_terminalMutex.
+ *
+ * @param  uint          pid  - program id
+ * @param  TRIGGER_BOOK* book - trigger book (NULL: the book was released)
+ */
+void WINAPI Program_SetTriggerBook(uint pid, TRIGGER_BOOK* book) {
+   if (pid && g_programStates.size() > pid) {
+      if (PROGRAM_STATE* state = g_programStates[pid])
+         state->triggerBook = book;
+   }
+}
+
+
+/**
+ * Whether a program has been retired (it's finished and its memory is or will be reclaimed).
+ *
+ * @param  uint pid - program id
+ *
+ * @return BOOL
+ */
+BOOL WINAPI Program_IsRetired(uint pid) {
+   if (pid && g_programStates.size() > pid) {
+      const PROGRAM_STATE* state = g_programStates[pid];
+      return(!state || state->retiredGeneration);                    // a reclaimed program has no state
+   }
+   return(FALSE);
+}
+
+
+/**
+ * Retire a finished program. The program's slot in g_mqlPrograms is replaced by a placeholder chain, so late readers never
+ * access released memory. The original chain is queued for reclamation. The program id is never reused.
+ *
+ * @param  uint pid - program id
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI Program_Retire(uint pid) {
+   if (!pid || g_mqlPrograms.size() <= pid) return(error(ERR_INVALID_PARAMETER, "invalid parameter pid: %d (no such program)", pid));
+   if (Program_IsRetired(pid))              return(TRUE);
+
+   if (!TryEnterCriticalSection(&g_terminalMutex)) {
+      debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+      EnterCriticalSection(&g_terminalMutex);
+   }
+   if (g_reclaimedChain.empty()) {
+      g_reclaimedChain.push_back(&g_reclaimedMaster);
+      g_reclaimedChain.push_back(NULL);
+   }
+   Limbo_Remove(pid);                                             // a finished program is never reloaded
+
+   ContextChain* chain = g_mqlPrograms[pid];
+   g_mqlPrograms[pid] = &g_reclaimedChain;                        // late readers see the placeholder chain...
+   RETIRED_PROGRAM retired = { pid, chain, InterlockedIncrement(&g_programGeneration) };   // ...before the new generation
+   g_retiredPrograms.push_back(retired);
+   g_programStates[pid]->retiredGeneration = retired.generation;
+   LeaveCriticalSection(&g_terminalMutex);
+   return(TRUE);
+}
+
+
+/**
+ * Release the memory of retired programs which can't be accessed anymore. A program retired in generation G is quiescent if
+ * every known thread either isn't linked to a program (it never executed one, it finished or it exited) or entered a program
+ * in generation G or later. Such a thread looked-up programs only after the retired program was replaced by the placeholder
+ * chain.
+ *
+ * @return uint - number of reclaimed programs
+ */
+uint WINAPI Program_Reclaim() {
+   if (!TryEnterCriticalSection(&g_terminalMutex)) {
+      debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+      EnterCriticalSection(&g_terminalMutex);
+   }
+   uint size = g_retiredPrograms.size(), threads = g_threads.size(), reclaimed = 0, n = 0;
+   std::vector<LogFile*> loggers;                                    // released after the lock: may flush and close files
+
+   LONG oldestEpoch = g_programGeneration + 1;                      // the oldest generation a thread may still access
+   for (uint t=0; t < threads; ++t) {
+      if (g_threadsPrograms[t]) oldestEpoch = std::min(oldestEpoch, (LONG)g_threadsEpochs[t]);
+   }
+
+   for (uint i=0; i < size; ++i) {
+      RETIRED_PROGRAM retired = g_retiredPrograms[i];
+      if (retired.generation > oldestEpoch) {                        // a thread may still access the program
+         g_retiredPrograms[n++] = retired;
+         continue;
+      }
+
+      EXECUTION_CONTEXT* master = (*retired.chain)[0];
+      if (master) {
+         if (master->test) TEST_release(master->test);
+
+         delete master->logBuffer;                                   // entries are released with the arena
+         if (master->logger) loggers.push_back(master->logger);      // the program's reference
+         delete master;
+      }
+      ReleaseTriggerBook(retired.pid);
+      Profiler_ReleaseProgram(retired.pid);
+      PROGRAM_STATE* state = g_programStates[retired.pid];
+      g_programStates[retired.pid] = NULL;                           // Program_IsRetired() stays TRUE
+      delete state;
+      delete retired.chain;
+      reclaimed++;
+   }
+   g_retiredPrograms.resize(n);
+   LeaveCriticalSection(&g_terminalMutex);
+
+   for (uint i=0, size=loggers.size(); i < size; ++i) {
+      Logfile_Release(loggers[i]);
+   }
+   if (reclaimed) LogWriter_StopIdle();                             // let the DLL unload after the last live program
+   return(reclaimed);
+}
+
+
+/**
+ * Return the number of live MQL programs, i.e. programs not yet retired.
+ *
+ * @return uint
+ */
+uint WINAPI Program_CountLive() {
+   return(g_mqlPrograms.size()-1 - g_programGeneration);            // index[0] is always empty, every program retires once
+}
+
+
+/**
+ * Set the logfile instance of a program. The master context holds a reference to the shared instance, a previously used
+ * instance is released. Programs loaded by iCustom() use the instance of the loading program.
+ *
+ * @param  EXECUTION_CONTEXT* master - master context of the program
+ * @param  LogFile*           logger - logfile instance (may be NULL)
+ */
+void WINAPI Program_SetLogger(EXECUTION_CONTEXT* master, LogFile* logger) {
+   if (master->logger == logger) return;
+
+   LogFile* previous = master->logger;
+   master->logger = logger ? Logfile_Share(logger) : NULL;
+   if (previous) Logfile_Release(previous);
+}
+
+
+/**
+ * Attach a cache of values to an MQL program. The cache survives init cycles (e.g. UR_CHARTCHANGE, UR_PARAMETERS) and lets a
+ * program skip warm-up work on re-initialization. It is dropped on a symbol change and when the program is released.
+ *
+ * @param  EXECUTION_CONTEXT* ec     - context of any module of the program
+ * @param  char*              key    - cache name (unique per program)
+ * @param  double             values - values to store
+ * @param  int                size   - number of values to store (0: delete the cache)
+ *
+ * @return int - number of stored values or EMPTY (-1) in case of errors
+ */
+int WINAPI Program_StoreCache(const EXECUTION_CONTEXT* ec, const char* key, const double values[], int size) {
+   if ((uint)ec < MIN_VALID_POINTER)               return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
+   if (!ec->pid || ec->pid >= g_programStates.size() || !g_programStates[ec->pid])
+                                                   return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid execution context (ec.pid=%d):  ec=%s", ec->pid, EXECUTION_CONTEXT_toStr(ec))));
+   if ((uint)key < MIN_VALID_POINTER)              return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter key: 0x%p (not a valid pointer)", key)));
+   if (size < 0)                                   return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size: %d", size)));
+   if (size && (uint)values < MIN_VALID_POINTER)   return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter values: 0x%p (not a valid pointer)", values)));
+
+   std::map<string, PROGRAM_CACHE> &caches = g_programStates[ec->pid]->caches;
+   if (!size) {
+      caches.erase(key);
+      return(0);
+   }
+   PROGRAM_CACHE &cache = caches[key];
+   cache.symbol = ec->symbol;
+   cache.values.assign(values, values + size);
+   return(size);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Copy the values of a cache attached to an MQL program to a caller-provided array. A cache stored for another symbol is
+ * dropped and reported as missing.
+ *
+ * @param  EXECUTION_CONTEXT* ec     - context of any module of the program
+ * @param  char*              key    - cache name
+ * @param  double             values - array receiving the cached values
+ * @param  int                size   - size of the passed array (may be 0 to query the number of cached values only)
+ *
+ * @return int - number of cached values (may exceed the array size), 0 if the cache doesn't exist or EMPTY (-1) in case of
+ *               errors
+ */
+int WINAPI Program_LoadCache(const EXECUTION_CONTEXT* ec, const char* key, double values[], int size) {
+   if ((uint)ec < MIN_VALID_POINTER)               return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
+   if (!ec->pid || ec->pid >= g_programStates.size() || !g_programStates[ec->pid])
+                                                   return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid execution context (ec.pid=%d):  ec=%s", ec->pid, EXECUTION_CONTEXT_toStr(ec))));
+   if ((uint)key < MIN_VALID_POINTER)              return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter key: 0x%p (not a valid pointer)", key)));
+   if (size < 0)                                   return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size: %d", size)));
+   if (size && (uint)values < MIN_VALID_POINTER)   return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter values: 0x%p (not a valid pointer)", values)));
+
+   std::map<string, PROGRAM_CACHE> &caches = g_programStates[ec->pid]->caches;
+   std::map<string, PROGRAM_CACHE>::iterator it = caches.find(key);
+   if (it == caches.end()) return(0);
+
+   const PROGRAM_CACHE &cache = it->second;
+   if (cache.symbol != ec->symbol) {                                 // the cached values belong to the previous symbol
+      caches.erase(it);
+      return(0);
+   }
+   uint cached = cache.values.size();
+   for (uint i=0, n=std::min((uint)size, cached); i < n; ++i) {
+      values[i] = cache.values[i];
+   }
+   return(cached);
+   #pragma EXPANDER_EXPORT
+}
@@ -11,6 +11,8 @@
 #include "lib/file.h"
 #include "lib/string.h"
 
+#include <algorithm>
+#include <istream>
 #include <winioctl.h>
 
 
@@ -347,6 +349,47 @@ const char* WINAPI GetReparsePointTargetA(const char* name) {
 }
 
 
+/**
+ * Search a binary stream for a byte sequence, starting at the current read position. Used by file decoders to resynchronize
+ * after corrupt data.
+ *
+ * @param  std::istream &input   - input stream opened in binary mode
+ * @param  char*         pattern - byte sequence to search for
+ * @param  uint          size    - size of the byte sequence (max. 64 bytes)
+ *
+ * @return int64 - stream offset of the byte sequence or -1 if the sequence was not found; if found the read position is set
+ *                 to the sequence
+ */
+int64 WINAPI FindInStream(std::istream &input, const char* pattern, uint size) {
+   if (!size || size > 64) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size: %d (must be 1...64)", size)));
+
+   char buffer[4096 + 64];
+   int64 position = (int64)input.tellg();                           // stream offset of buffer[0]
+   if (position < 0) return(-1);
+   uint kept = 0;
+
+   while (true) {
+      input.read(buffer + kept, 4096);
+      uint n = kept + (uint)input.gcount();
+
+      for (uint i=0; i+size <= n; ++i) {
+         if (buffer[i]==pattern[0] && !memcmp(buffer + i, pattern, size)) {
+            input.clear();
+            input.seekg(position + i);
+            return(position + i);
+         }
+      }
+      if (!input) break;                                             // end of stream
+
+      kept = std::min(n, size-1);                                    // a sequence may span two reads
+      memmove(buffer, buffer + n - kept, kept);
+      position += n - kept;
+   }
+   input.clear();
+   return(-1);
+}
+
+
 // @see  PathCanonicalize()
 // @see  https://stackoverflow.com/questions/1816691/how-do-i-resolve-a-canonical-filename-in-windows
 // @see  http://pdh11.blogspot.com/2009/05/pathcanonicalize-versus-what-it-says-on.html
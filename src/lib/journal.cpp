@@ -0,0 +1,190 @@
+#include "expander.h"
+#include "lib/conversion.h"
+#include "lib/journal.h"
+
+#include <fstream>
+
+
+JOURNAL_RECORD g_journal[JOURNAL_SIZE];                     // ring buffer of lifecycle records
+volatile LONG  g_journalNext;                               // sequence number of the next record
+FILETIME       g_journalStartTime;                          // system time at journal initialization
+LONGLONG       g_journalStartCounter;                       // performance counter at journal initialization
+double         g_journalNsecPerTick = 1;                    // nanoseconds per performance counter tick
+
+
+/**
+ * Initialize the journal. Called only in DLL::onProcessAttach().
+ */
+void WINAPI InitJournal() {
+   LARGE_INTEGER frequency, counter;
+   if (QueryPerformanceFrequency(&frequency) && frequency.QuadPart > 0)
+      g_journalNsecPerTick = 1000000000. / frequency.QuadPart;
+
+   QueryPerformanceCounter(&counter);
+   GetSystemTimeAsFileTime(&g_journalStartTime);
+   g_journalStartCounter = counter.QuadPart;
+}
+
+
+/**
+ * Append a lifecycle record to the journal. The function is called on every context transition, so it doesn't lock and
+ * doesn't format anything: a slot is claimed by incrementing the sequence counter and is published by storing its sequence
+ * number after all fields have been written. If the ring buffer wraps the oldest records are overwritten.
+ *
+ * @param  uint               event                   - journal event id
+ * @param  EXECUTION_CONTEXT* ec                      - execution context of the calling module (may be NULL)
+ * @param  char*              moduleName   [optional] - module name if not yet stored in the context (default: ec.moduleName)
+ * @param  UninitializeReason uninitReason [optional] - uninit reason as passed by the terminal (default: UR_UNDEFINED)
+ */
+void WINAPI Journal_Record(uint event, const EXECUTION_CONTEXT* ec, const char* moduleName/*=NULL*/, UninitializeReason uninitReason/*=UR_UNDEFINED*/) {
+   LARGE_INTEGER counter;
+   QueryPerformanceCounter(&counter);
+
+   uint sequence = (uint)InterlockedIncrement(&g_journalNext) - 1;
+   JOURNAL_RECORD &record = g_journal[sequence % JOURNAL_SIZE];
+   InterlockedExchange(&record.sequence, 0);                         // mark the slot as being written
+
+   record.event        = event;
+   record.time         = (uint64)((counter.QuadPart - g_journalStartCounter) * g_journalNsecPerTick);
+   record.threadId     = GetCurrentThreadId();
+   record.uninitReason = uninitReason;
+
+   if ((uint)ec >= MIN_VALID_POINTER) {
+      record.pid          = ec->pid;
+      record.moduleType   = ec->moduleType;
+      record.coreFunction = ec->moduleCoreFunction;
+      record.initReason   = ec->programInitReason;
+      if (!moduleName) moduleName = ec->moduleName;
+   }
+   else {
+      record.pid          = NULL;
+      record.moduleType   = (ModuleType)NULL;
+      record.coreFunction = (CoreFunction)NULL;
+      record.initReason   = (InitializeReason)NULL;
+   }
+   if ((uint)moduleName < MIN_VALID_POINTER) moduleName = "";
+   strncpy(record.moduleName, moduleName, sizeof(record.moduleName)-1);
+   record.moduleName[sizeof(record.moduleName)-1] = '\0';
+
+   InterlockedExchange(&record.sequence, sequence + 1);              // publish the record
+}
+
+
+/**
+ * Return the name of a journal event.
+ *
+ * @param  uint event
+ *
+ * @return char*
+ */
+const char* WINAPI Journal_EventToStr(uint event) {
+   switch (event) {
+      case JOURNAL_SYNCMAINCONTEXT_INIT  : return("SyncMainContext_init");
+      case JOURNAL_SYNCMAINCONTEXT_INITED: return("SyncMainContext_init:ok");
+      case JOURNAL_SYNCMAINCONTEXT_DEINIT: return("SyncMainContext_deinit");
+      case JOURNAL_SYNCLIBCONTEXT_INIT   : return("SyncLibContext_init");
+      case JOURNAL_SYNCLIBCONTEXT_INITED : return("SyncLibContext_init:ok");
+      case JOURNAL_SYNCLIBCONTEXT_DEINIT : return("SyncLibContext_deinit");
+      case JOURNAL_LEAVECONTEXT          : return("LeaveContext");
+   }
+   return(NULL);
+}
+
+
+/**
+ * Save the current content of the journal to a binary file. Records are written in chronological order. Records being
+ * overwritten while the journal is saved are skipped.
+ *
+ * @param  char* filename - full filename
+ *
+ * @return int - number of saved records or EMPTY (-1) in case of errors
+ */
+int WINAPI Journal_Save(const char* filename) {
+   if ((uint)filename < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter filename: 0x%p (not a valid pointer)", filename)));
+   if (!*filename)                         return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter filename: \"\" (empty)")));
+
+   std::ofstream file(filename, std::ios::binary|std::ios::trunc);
+   if (!file.is_open()) return(_EMPTY(error(ERR_WIN32_ERROR+GetLastError(), "cannot open file \"%s\" (%s)", filename, strerror(errno))));
+
+   JOURNAL_FILE_HEADER header = {};
+   strcpy(header.magic, "RSFJRNL");
+   header.version    = JOURNAL_FILE_VERSION;
+   header.recordSize = sizeof(JOURNAL_RECORD);
+   header.startTime  = g_journalStartTime;
+   file.write((char*)&header, sizeof(header));                       // the record count is updated at the end
+
+   uint next  = (uint)g_journalNext;
+   uint first = (next > JOURNAL_SIZE) ? next-JOURNAL_SIZE : 0;
+   JOURNAL_RECORD record;
+
+   for (uint sequence=first; sequence < next; ++sequence) {
+      const JOURNAL_RECORD &slot = g_journal[sequence % JOURNAL_SIZE];
+      if ((uint)slot.sequence != sequence+1) continue;               // not yet published or already overwritten
+      record = slot;
+      if ((uint)slot.sequence != sequence+1) continue;               // overwritten while copying
+      file.write((char*)&record, sizeof(record));
+      header.records++;
+   }
+   file.seekp(0);
+   file.write((char*)&header, sizeof(header));
+   file.close();
+
+   if (file.fail()) return(_EMPTY(error(ERR_WIN32_ERROR+GetLastError(), "cannot write file \"%s\" (%s)", filename, strerror(errno))));
+   return(header.records);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Decode a binary journal file created by Journal_Save() to a human-readable text file. One line per record.
+ *
+ * @param  char* journalFile - full filename of the binary journal
+ * @param  char* outputFile  - full filename of the text file to create
+ *
+ * @return int - number of decoded records or EMPTY (-1) in case of errors
+ */
+int WINAPI Journal_Decode(const char* journalFile, const char* outputFile) {
+   if ((uint)journalFile < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter journalFile: 0x%p (not a valid pointer)", journalFile)));
+   if (!*journalFile)                         return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter journalFile: \"\" (empty)")));
+   if ((uint)outputFile < MIN_VALID_POINTER)  return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter outputFile: 0x%p (not a valid pointer)", outputFile)));
+   if (!*outputFile)                          return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter outputFile: \"\" (empty)")));
+
+   std::ifstream input(journalFile, std::ios::binary);
+   if (!input.is_open()) return(_EMPTY(error(ERR_WIN32_ERROR+GetLastError(), "cannot open file \"%s\" (%s)", journalFile, strerror(errno))));
+
+   JOURNAL_FILE_HEADER header;
+   input.read((char*)&header, sizeof(header));
+   if (!input || memcmp(header.magic, "RSFJRNL", 8)) return(_EMPTY(error(ERR_RUNTIME_ERROR, "not a journal file: \"%s\"", journalFile)));
+   if (header.version != JOURNAL_FILE_VERSION)       return(_EMPTY(error(ERR_RUNTIME_ERROR, "unsupported journal version %d in file \"%s\"", header.version, journalFile)));
+   if (header.recordSize != sizeof(JOURNAL_RECORD))  return(_EMPTY(error(ERR_RUNTIME_ERROR, "unsupported record size %d in file \"%s\"", header.recordSize, journalFile)));
+
+   std::ofstream output(outputFile, std::ios::trunc);
+   if (!output.is_open()) return(_EMPTY(error(ERR_WIN32_ERROR+GetLastError(), "cannot open file \"%s\" (%s)", outputFile, strerror(errno))));
+
+   uint64 startTime = ((uint64)header.startTime.dwHighDateTime << 32) | header.startTime.dwLowDateTime;
+   JOURNAL_RECORD record;
+   char line[512];
+   uint records = 0;
+
+   while (records < header.records && input.read((char*)&record, sizeof(record))) {
+      uint64 fileTime = startTime + record.time/100;                 // FILETIME resolution is 100 nsec
+      FILETIME ft = { (DWORD)fileTime, (DWORD)(fileTime >> 32) };
+      SYSTEMTIME st;
+      FileTimeToSystemTime(&ft, &st);
+      uint nsec = (uint)(fileTime % 10000000)*100 + (uint)(record.time % 100);
+
+      const char* event = Journal_EventToStr(record.event);
+      sprintf_s(line, sizeof(line), "%04d.%02d.%02d %02d:%02d:%02d.%09d  thread=%-5d  pid=%-4d  %-23s  %-12s  %-24s  %-12s  %-20s  %s",
+         st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, nsec, record.threadId, record.pid,
+         (event ? event : "(unknown event)"), (record.moduleType ? ModuleTypeToStr(record.moduleType) : "-"), record.moduleName,
+         (record.coreFunction ? CoreFunctionToStr(record.coreFunction) : "-"), (record.initReason ? InitReasonToStr(record.initReason) : "-"),
+         UninitReasonToStr(record.uninitReason));
+      output << line << "\n";
+      records++;
+   }
+   output.close();
+
+   if (records != header.records) warn(ERR_RUNTIME_ERROR, "truncated journal file \"%s\" (%d of %d records)", journalFile, records, header.records);
+   return(records);
+   #pragma EXPANDER_EXPORT
+}
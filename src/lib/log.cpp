@@ -1,14 +1,32 @@
+#define DIAG_MODULE DIAG_LOG
 #include "expander.h"
+#include "lib/binarylog.h"
 #include "lib/datetime.h"
 #include "lib/file.h"
 #include "lib/conversion.h"
+#include "lib/executioncontext.h"
+#include "lib/log.h"
+#include "lib/logwriter.h"
+#include "lib/memory.h"
+#include "lib/profiler.h"
 #include "lib/string.h"
 #include "struct/rsf/ExecutionContext.h"
 
 #include <fstream>
+#include <map>
 #include <time.h>
 
-extern MqlProgramList g_mqlPrograms;               // all MQL programs: vector<ContextChain*> with index = program id
+extern CRITICAL_SECTION g_terminalMutex;           // mutex for application-wide locking
+extern MqlProgramList   g_mqlPrograms;             // all MQL programs: vector<ContextChain*> with index = program id
+
+typedef std::map<string, LogFile*> LogFiles;       // logfile instances by canonical filename
+
+LogFiles g_logfiles;                                  // shared logfile instances of all programs
+uint     g_logfileRotationSize  = LOGFILE_ROTATION_SIZE; // max. logfile segment size (0: no size-based rotation)
+BOOL     g_logfileRotationDaily = TRUE;               // whether to start a new logfile segment at the begin of a calendar day
+
+uint           g_logRepeatInterval = LOGFILTER_REPEAT_INTERVAL;   // max. time in msec repeats are collapsed (default: no suppression)
+LOG_RATE_LIMIT g_logRateLimits[LOGFILTER_LEVELS];                 // rate limits by loglevel index (default: unlimited)
 
 
 /**
@@ -23,6 +41,7 @@ extern MqlProgramList g_mqlPrograms;               // all MQL programs: vector<C
  * @return BOOL - success status
  */
 BOOL WINAPI AppendLogMessageA(EXECUTION_CONTEXT* ec, datetime time, const char* message, int error, int level) {
+   LatencyProbe probe(PROBE_APPENDLOGMESSAGE);                       // measure the DLL latency of the call
    if ((uint)ec < MIN_VALID_POINTER)      return(error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec));
    if (!ec->pid)                          return(error(ERR_INVALID_PARAMETER, "invalid execution context: ec.pid=0  ec=%s", EXECUTION_CONTEXT_toStr(ec)));
    if (g_mqlPrograms.size() <= ec->pid)   return(error(ERR_ILLEGAL_STATE,     "invalid execution context: ec.pid=%d (no such program)  ec=%s", ec->pid, EXECUTION_CONTEXT_toStr(ec)));
@@ -40,62 +59,147 @@ BOOL WINAPI AppendLogMessageA(EXECUTION_CONTEXT* ec, datetime time, const char*
    BOOL useLogBuffer = (!useLogger && master->programInitFlags & INIT_BUFFERED_LOG);
    if (!useLogger && !useLogBuffer) return(FALSE);                                        // logger and buffered log are inactive
 
+   // check repeat suppression and rate limits before any formatting (in tester in modeled time)
+   LogFilter* filter = Program_GetLogFilter(ec->pid);
+   if (filter) {
+      DWORD now = ec->testing ? (DWORD)((uint64)time * 1000) : GetTickCount();
+      if (!filter->pass(level, error, message, now)) return(FALSE);                       // suppressed: no formatting, no I/O
+
+      int repeatedLevel;
+      uint repeated = filter->repeated(repeatedLevel);
+      AppendLogSummary(ec, master, useLogger, time, repeated, repeatedLevel, filter->dropped(level), level);
+   }
+   return(AppendLogEntry(ec, master, useLogger, time, message, error, level));
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Write the summaries of a program's log filter: the number of suppressed repeats of a message and the number of messages
+ * dropped by the rate limit.
+ *
+ * @param  EXECUTION_CONTEXT* ec            - execution context of the program
+ * @param  EXECUTION_CONTEXT* master        - master context of the program
+ * @param  BOOL               useLogger     - whether to write to the logfile (otherwise to the logbuffer)
+ * @param  datetime           time          - current time (used only in tester)
+ * @param  uint               repeated      - number of suppressed repeats
+ * @param  int                repeatedLevel - loglevel of the repeated message
+ * @param  uint               dropped       - number of dropped messages
+ * @param  int                droppedLevel  - loglevel of the dropped messages
+ */
+void WINAPI AppendLogSummary(EXECUTION_CONTEXT* ec, EXECUTION_CONTEXT* master, BOOL useLogger, datetime time, uint repeated, int repeatedLevel, uint dropped, int droppedLevel) {
+   char summary[80];
+   if (repeated) {
+      sprintf(summary, "(previous message repeated %d times)", repeated);
+      AppendLogEntry(ec, master, useLogger, time, summary, NO_ERROR, repeatedLevel);
+   }
+   if (dropped) {
+      sprintf(summary, "(%d %s messages dropped by the rate limit)", dropped, LoglevelDescriptionA(droppedLevel));
+      AppendLogEntry(ec, master, useLogger, time, summary, NO_ERROR, droppedLevel);
+   }
+}
+
+
+/**
+ * Write the pending counts of a program's log filter, e.g. before the program's logfile is closed. Otherwise the suppressed
+ * repeats of the last message and the messages dropped by the rate limit after it would be lost.
+ *
+ * @param  EXECUTION_CONTEXT* ec - execution context of the program
+ *
+ * @return BOOL - whether pending counts were written
+ */
+BOOL WINAPI FlushLogFilter(EXECUTION_CONTEXT* ec) {
+   LogFilter* filter = Program_GetLogFilter(ec->pid);
+   if (!filter) return(FALSE);
+
+   int repeatedLevel;
+   uint dropped[LOGFILTER_LEVELS];
+   uint repeated = filter->flush(repeatedLevel, dropped);
+
+   EXECUTION_CONTEXT* master = (*g_mqlPrograms[ec->pid])[0];
+   if (!master) return(FALSE);
+   BOOL useLogger = (master->logger && strlen(master->logFilename));
+   if (!useLogger && !(master->programInitFlags & INIT_BUFFERED_LOG)) return(FALSE);
+
+   BOOL written = (repeated != 0);
+   AppendLogSummary(ec, master, useLogger, ec->currTickTime, repeated, repeatedLevel, 0, 0);
+   for (int i=0; i < LOGFILTER_LEVELS; ++i) {
+      if (dropped[i]) {
+         AppendLogSummary(ec, master, useLogger, ec->currTickTime, 0, 0, dropped[i], LOG_DEBUG << i);
+         written = TRUE;
+      }
+   }
+   return(written);
+}
+
+
+/**
+ * Format a log message and write it to the program's logfile or logbuffer. Called after all filters have been applied.
+ *
+ * @param  EXECUTION_CONTEXT* ec        - execution context of the program
+ * @param  EXECUTION_CONTEXT* master    - master context of the program
+ * @param  BOOL               useLogger - whether to write to the logfile (otherwise to the logbuffer)
+ * @param  datetime           time      - current time (used only in tester)
+ * @param  char*              message   - log message
+ * @param  int                error     - error linked to the message (if any)
+ * @param  int                level     - log level of the message
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI AppendLogEntry(EXECUTION_CONTEXT* ec, EXECUTION_CONTEXT* master, BOOL useLogger, datetime time, const char* message, int error, int level) {
+   BOOL useBinaryLog = (master->programInitFlags & INIT_BINARY_LOG);
+
    // open a closed logger
    if (useLogger && !master->logger->is_open()) {
-      if (!IsFileA(master->logFilename)) {
-         char drive[MAX_DRIVE], dir[MAX_DIR];                                             // extract the directory part of logFilename
-         _splitpath(master->logFilename, drive, dir, NULL, NULL);
-         if (CreateDirectoryA(string(drive).append(dir), MKDIR_PARENT))                   // make sure the directory exists
-            return(FALSE);
-      }
-      master->logger->open(master->logFilename, std::ios::binary|std::ios::app);          // open the logfile
-      if (!master->logger->is_open()) return(error(ERR_WIN32_ERROR+GetLastError(), "opening of \"%s\" failed (%s)", master->logFilename, strerror(errno)));
-      if (master->logBuffer && master->logBuffer->size()) {
-         uint size = master->logBuffer->size();
-         for (uint i=0; i < size; ++i) {
-            string* entry = (*master->logBuffer)[i];
-            *master->logger << *entry << NL;                                              // flush existing logbuffer entries
-            delete entry;
-         }
-         master->logger->flush();
-         master->logBuffer->clear();
-      }
+      if (!Logfile_Open(master)) return(FALSE);
    }
-   else if (useLogBuffer && !master->logBuffer) {
+   else if (!useLogger && !master->logBuffer) {
       master->logBuffer = ec->logBuffer = new LogBuffer();
-      master->logBuffer->reserve(16);
    }
 
-   // compose the log entry
-   std::ostringstream ss;
-   string sLoglevel(level==LOG_INFO ? "": LoglevelDescriptionA(level));                   // loglevel (INFO is blanked out)
-   string sExecPath(ec->programName); sExecPath.append("::");                             // execution path
-   if (ec->moduleType == MT_LIBRARY) sExecPath.append(ec->moduleName).append("::");       //
-   string sMessage(message); StrReplace(StrReplace(sMessage, "\r\n", "\n"), "\n", " ");   // replace linebreaks with spaces
-   string sError; if (error) sError.append("  [").append(ErrorToStr(error)).append("]");  // error description
+   // compose the log entry in the thread's scratch buffer (no heap allocations in steady state)
+   HotPath hotPath;
+   if (useLogger && useBinaryLog) {
+      return(BinaryLog_Append(ec, master->logger, time, message, error, level));          // no text formatting at all
+   }
+   const char* sLoglevel = (level==LOG_INFO) ? "" : LoglevelDescriptionA(level);      // loglevel (INFO is blanked out)
+   const char* sPeriod   = PeriodDescription(ec->timeframe);
+   const char* sError    = error ? ErrorToStr(error) : NULL;                            // error description
+   uint size = 64 + strlen(ec->symbol) + strlen(sPeriod) + strlen(ec->programName) + strlen(ec->moduleName) + strlen(message) + (sError ? strlen(sError) : 0);
+
+   char* buffer = GetScratchBuffer(size);
+   if (!buffer) return(FALSE);
+   char* pos = buffer;
 
    if (ec->testing) {                                                                     // generate the appropriate time string
-      size_t bufSize = 20;
-      char* buffer = (char*)alloca(bufSize);
-      gmtimeFormat(buffer, bufSize, time, "%Y-%m-%d %H:%M:%S");                           // tester: time with seconds
-      ss << "Tester " << buffer;
+      pos += sprintf(pos, "Tester ");
+      pos += gmtimeFormat(pos, 20, time, "%Y-%m-%d %H:%M:%S");                            // tester: time with seconds
    }
    else {
       SYSTEMTIME st; GetLocalTime(&st);
-      size_t bufSize = 20;
-      char* buffer = (char*)alloca(bufSize);
-      localtimeFormat(buffer, bufSize, st, "%Y-%m-%d %H:%M:%S");
-      ss << buffer << "." << std::setw(3) << std::setfill('0') << st.wMilliseconds;       // online: time with milliseconds
+      pos += localtimeFormat(pos, 20, st, "%Y-%m-%d %H:%M:%S");                           // cached per second
+      pos[0] = '.';                                                                       // online: patch in milliseconds
+      pos[1] = '0' + st.wMilliseconds/100;
+      pos[2] = '0' + st.wMilliseconds/10%10;
+      pos[3] = '0' + st.wMilliseconds%10;
+      pos += 4;
+   }
+   pos += sprintf(pos, " %-6s %s,%s  %s::", sLoglevel, ec->symbol, sPeriod, ec->programName);
+   if (ec->moduleType == MT_LIBRARY) pos += sprintf(pos, "%s::", ec->moduleName);         // execution path
+
+   for (const char* c=message; *c; ++c) {                                                 // replace linebreaks with spaces
+      if (*c=='\r' && c[1]=='\n') ++c;
+      *pos++ = (*c=='\n') ? ' ' : *c;
    }
-   ss << " " << std::setw(6) << std::setfill(' ') << std::left << sLoglevel << " " << ec->symbol << "," << PeriodDescription(ec->timeframe) << "  " << sExecPath << sMessage << sError;
+   if (sError) pos += sprintf(pos, "  [%s]", sError);
+   *pos++ = '\n';
 
    // write the log entry to logfile or logbuffer
-   if (useLogger) *master->logger << ss.str() << std::endl;
-   else           master->logBuffer->push_back(new string(ss.str()));
+   if (useLogger) LogWriter_Append(master->logger, buffer, pos-buffer);                   // written asynchronously
+   else           master->logBuffer->append(buffer, pos-buffer);                          // copied to the buffer's arena
 
    // @see  https://www.codeguru.com/cpp/cpp/date_time/routines/article.php/c1615/Extended-Time-Format-Functions-with-Milliseconds.htm
    return(TRUE);
-   #pragma EXPANDER_EXPORT
 }
 
 
@@ -118,47 +222,244 @@ BOOL WINAPI SetLogfileA(EXECUTION_CONTEXT* ec, const char* filename) {
    EXECUTION_CONTEXT* master = chain[0];
 
    if (filename && *filename) {
-      // enable the file logger
-      std::ofstream* log = master->logger;
-      if (!log) log = master->logger = ec->logger = new std::ofstream();
-
-      // close a different previous logfile
-      if (!StrCompare(filename, master->logFilename)) {
-         if (log->is_open()) log->close();
-      }
+      // enable the file logger: switch to the shared instance of the file (the previous instance is released)
+      LogFile* log = Logfile_Acquire(filename, master->programInitFlags);
+      if (!log) return(FALSE);
+      Program_SetLogger(master, log);
+      Logfile_Release(log);                                                      // the master context holds the reference
+      ec->logger = log;
       ec_SetLogFilename(ec, filename);
 
-      // open the new logfile if the logfile appender is not disabled
+      // open the logfile if the logfile appender is not disabled
       if (master->loglevel!=LOG_OFF && master->loglevelFile!=LOG_OFF) {
-         if (!log->is_open()) {
-            if (!IsFileA(filename)) {
-               char drive[MAX_DRIVE], dir[MAX_DIR];                              // extract the directory part of logFilename
-               _splitpath(filename, drive, dir, NULL, NULL);
-               if (CreateDirectoryA(string(drive).append(dir), MKDIR_PARENT))    // make sure the directory exists
-                  return(FALSE);
-            }
-            log->open(filename, std::ios::binary|std::ios::app);                 // open the logfile
-            if (!log->is_open()) return(error(ERR_WIN32_ERROR+GetLastError(), "opening of \"%s\" failed (%s)", filename, strerror(errno)));
-            if (master->logBuffer && master->logBuffer->size()) {
-               uint size = master->logBuffer->size();
-               for (uint i=0; i < size; ++i) {
-                  string* entry = (*master->logBuffer)[i];
-                  *master->logger << *entry << NL;                               // flush existing logbuffer entries
-                  delete entry;
-               }
-               master->logger->flush();
-               master->logBuffer->clear();
-            }
+         if (!log->is_open() || (master->logBuffer && master->logBuffer->size())) {
+            if (!Logfile_Open(master)) return(FALSE);
          }
       }
    }
    else {
-      // close the logfile but keep an existing instance (we may be in an init cycle)
-      if (master->logger && master->logger->is_open())
-         master->logger->close();
+      // disable the file logger: release the instance (it's closed if no other program uses it)
+      Program_SetLogger(master, NULL);
+      ec->logger = NULL;
       ec_SetLogFilename(ec, filename);
    }
 
    return(TRUE);
    #pragma EXPANDER_EXPORT
 }
+
+
+/**
+ * Configure the rotation of all program logfiles. Changes take effect with the next log entry.
+ *
+ * @param  int  maxSize - max. size of a logfile segment in bytes (0: no size-based rotation)
+ * @param  BOOL daily   - whether to start a new segment at the begin of a calendar day
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI SetLogfileRotation(int maxSize, BOOL daily) {
+   if (maxSize < 0) return(error(ERR_INVALID_PARAMETER, "invalid parameter maxSize: %d (must be non-negative)", maxSize));
+
+   g_logfileRotationSize  = maxSize;
+   g_logfileRotationDaily = (daily != 0);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Configure the suppression of repeated log messages. Identical messages of a program (same loglevel, error and text) are
+ * collapsed into a single "repeated N times" entry. In tester the interval refers to modeled time. Changes take effect with
+ * the next log message. Suppression is disabled by default.
+ *
+ * @param  int interval - max. time in milliseconds repeats of a message are collapsed (0: no suppression)
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI SetLogRepeatSuppression(int interval) {
+   if (interval < 0) return(error(ERR_INVALID_PARAMETER, "invalid parameter interval: %d (must be non-negative)", interval));
+
+   g_logRepeatInterval = interval;
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Configure the rate limit of a loglevel. Each program may log a burst of messages of the loglevel, after that messages
+ * exceeding the rate are dropped. The number of dropped messages is logged with the next passing message or when the program
+ * is deinitialized. In tester the rate refers to modeled time. Changes take effect with the next log message.
+ *
+ * @param  int level - loglevel: LOG_DEBUG | LOG_INFO | LOG_NOTICE | LOG_WARN | LOG_ERROR | LOG_FATAL
+ * @param  int rate  - max. number of messages per second (0: unlimited)
+ * @param  int burst - max. number of messages in a burst (min. 1)
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI SetLogRateLimit(int level, int rate, int burst) {
+   if (level < LOG_DEBUG || level > LOG_FATAL || level & (level-1)) return(error(ERR_INVALID_PARAMETER, "invalid parameter level: %d (not a loglevel)", level));
+   if (rate < 0)                                                    return(error(ERR_INVALID_PARAMETER, "invalid parameter rate: %d (must be non-negative)", rate));
+   if (burst < 0)                                                   return(error(ERR_INVALID_PARAMETER, "invalid parameter burst: %d (must be non-negative)", burst));
+
+   LOG_RATE_LIMIT &limit = g_logRateLimits[LogFilter::levelIndex(level)];
+   limit.rate  = rate;
+   limit.burst = std::max(burst, 1);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return the shared logfile instance for a filename and create it on first use. Programs logging to the same file share a
+ * single instance: one file handle, one stream buffer and one serialized output path through the log writer. The caller
+ * holds a reference which must be released with Logfile_Release(). All programs sharing a logfile must use the same log
+ * format, a program using a different format is rejected.
+ *
+ * @param  char* filename
+ * @param  DWORD format   - init flags of the program: INIT_BINARY_LOG and INIT_COMPRESSED_LOG select the log format
+ *
+ * @return LogFile* - logfile instance or NULL in case of errors
+ */
+LogFile* WINAPI Logfile_Acquire(const char* filename, DWORD format) {
+   char fullName[MAX_PATH];
+   DWORD length = GetFullPathNameA(filename, MAX_PATH, fullName, NULL);
+   if (!length || length >= MAX_PATH) return((LogFile*)error(ERR_WIN32_ERROR+GetLastError(), "GetFullPathNameA() failed for \"%s\"", filename));
+   string key(fullName);
+   StrToLower(key);                                                  // file names are case-insensitive
+
+   if (!TryEnterCriticalSection(&g_terminalMutex)) {
+      debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+      EnterCriticalSection(&g_terminalMutex);
+   }
+   format &= (INIT_BINARY_LOG|INIT_COMPRESSED_LOG);
+   LogFile* &logger = g_logfiles[key];
+   if (!logger) {
+      logger = new LogFile();
+      logger->setFormat(format);
+   }
+   else if (logger->format() != format) {
+      DWORD used = logger->format();
+      LeaveCriticalSection(&g_terminalMutex);
+      return((LogFile*)error(ERR_ILLEGAL_STATE, "logfile \"%s\" is used by another program in a different format (%s instead of %s)", filename, InitFlagsToStr(used), InitFlagsToStr(format)));
+   }
+   logger->addReference();
+   LeaveCriticalSection(&g_terminalMutex);
+
+   return(logger);
+}
+
+
+/**
+ * Add a reference to a logfile instance already referenced by the caller.
+ *
+ * @param  LogFile* logger
+ *
+ * @return LogFile* - the same instance
+ */
+LogFile* WINAPI Logfile_Share(LogFile* logger) {
+   if (!TryEnterCriticalSection(&g_terminalMutex)) {
+      debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+      EnterCriticalSection(&g_terminalMutex);
+   }
+   logger->addReference();
+   LeaveCriticalSection(&g_terminalMutex);
+   return(logger);
+}
+
+
+/**
+ * Release a reference to a logfile instance. After the last reference is released the instance is removed from the
+ * registry, and queued entries are written and the logfile is closed and deleted. The instance is unreachable at that
+ * point, so this happens outside of the registry lock (lock order: g_terminalMutex is never held while entering
+ * g_logWriterMutex).
+ *
+ * @param  LogFile* logger
+ */
+void WINAPI Logfile_Release(LogFile* logger) {
+   if (!TryEnterCriticalSection(&g_terminalMutex)) {
+      debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+      EnterCriticalSection(&g_terminalMutex);
+   }
+   BOOL unused = !logger->releaseReference();
+   if (unused) {
+      for (LogFiles::iterator it=g_logfiles.begin(), end=g_logfiles.end(); it != end; ++it) {
+         if (it->second == logger) {
+            g_logfiles.erase(it);
+            break;
+         }
+      }
+   }
+   LeaveCriticalSection(&g_terminalMutex);
+
+   if (unused) {
+      LogWriter_Flush();                                             // write queued entries before releasing
+      logger->close();
+      BinaryLog_Release(logger);
+      delete logger;
+   }
+}
+
+
+/**
+ * Open a program's logfile if it's closed and flush the program's log buffer to it. A newly opened binary logfile starts a
+ * new session. The compression mode is set by the program opening the logfile. The logfile may be shared with other
+ * programs, so buffered entries are queued like regular entries. Entries evicted from a full log buffer are reported.
+ *
+ * @param  EXECUTION_CONTEXT* master - master context of the program
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI Logfile_Open(EXECUTION_CONTEXT* master) {
+   LogFile* logger = master->logger;
+   BOOL useBinaryLog = (master->programInitFlags & INIT_BINARY_LOG);
+   LogWriter_Start();                                                // the writer may have stopped with the last program
+
+   if (!TryEnterCriticalSection(&g_terminalMutex)) {
+      debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+      EnterCriticalSection(&g_terminalMutex);
+   }
+   BOOL success = TRUE, opened = FALSE;
+   logger->lock();                                                   // wait for a rotation in progress
+   if (!logger->is_open()) {
+      logger->setCompressed(master->programInitFlags & INIT_COMPRESSED_LOG);
+      success = opened = logger->open(master->logFilename);          // the directory is checked on first use only
+   }
+   logger->unlock();
+   if (opened && useBinaryLog) BinaryLog_Open(logger);               // start a new binary log session
+   LeaveCriticalSection(&g_terminalMutex);
+   if (!success) return(FALSE);
+
+   if (master->logBuffer && master->logBuffer->size()) {             // flush existing logbuffer entries
+      if (uint evicted = master->logBuffer->evicted()) {             // report entries lost to the size cap first
+         char summary[64];
+         sprintf(summary, "(%d earlier log entries evicted from the log buffer)", evicted);
+         AppendLogEntry(master, master, TRUE, master->currTickTime, summary, NO_ERROR, LOG_WARN);
+      }
+      if (useBinaryLog) BinaryLog_AppendText(logger, master->logBuffer->data(), master->logBuffer->length());
+      else              LogWriter_Append(logger, master->logBuffer->data(), master->logBuffer->length());
+      master->logBuffer->clear();
+   }
+   return(TRUE);
+}
+
+
+/**
+ * Close a program's logfile if no other program uses it. It's re-opened on next use.
+ *
+ * @param  LogFile* logger
+ */
+void WINAPI Logfile_Close(LogFile* logger) {
+   if (!TryEnterCriticalSection(&g_terminalMutex)) {
+      debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+      EnterCriticalSection(&g_terminalMutex);
+   }
+   BOOL unshared = (logger->references() <= 1 && logger->is_open());
+   LeaveCriticalSection(&g_terminalMutex);
+
+   if (unshared) {                                                   // no I/O under the registry lock
+      LogWriter_Flush();                                             // write queued entries before closing
+      logger->lock();
+      logger->close();
+      logger->unlock();
+   }
+}
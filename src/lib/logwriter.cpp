@@ -0,0 +1,288 @@
+#define DIAG_MODULE DIAG_LOG
+#include "expander.h"
+#include "lib/executioncontext.h"
+#include "lib/logwriter.h"
+#include "lib/memory.h"
+
+#include <process.h>
+
+
+LOG_RECORD       g_logQueue[LOG_QUEUE_SIZE];                // bounded MPSC queue of log entries
+volatile LONG    g_logQueueTail;                            // next queue position to be claimed by a producer
+LONG             g_logQueueHead;                            // next queue position to be written (consumer only)
+CRITICAL_SECTION g_logWriterMutex;                          // held by the consumer (writer thread or a flushing thread)
+HANDLE           g_logWriterEvent;                          // wakes up the writer thread
+HANDLE           g_logWriterThread;
+HMODULE          g_logWriterModule;                         // the DLL reference held by the writer thread
+volatile LONG    g_logWriterStop;                           // whether the writer thread should terminate
+BOOL             g_logWriterShutdown;                       // whether the writer was shut down for good (no restarts)
+CRITICAL_SECTION g_logWriterControl;                        // serializes starting and stopping of the writer thread
+
+
+/**
+ * Flush the logfiles touched by a batch.
+ *
+ * @param  LogFile* loggers[] - logfiles
+ * @param  uint     &size     - number of logfiles (reset to 0)
+ */
+void WINAPI LogWriter_FlushLoggers(LogFile* loggers[], uint &size) {
+   while (size) {
+      LogFile* logger = loggers[--size];
+      logger->lock();
+      logger->flush();
+      logger->unlock();
+   }
+}
+
+
+/**
+ * Write all published queue entries to their logfiles and flush the logfiles. Must be called by the consumer only, i.e.
+ * while holding g_logWriterMutex.
+ *
+ * @return uint - number of written entries
+ */
+uint WINAPI LogWriter_Drain() {
+   LogFile* loggers[32];                                             // logfiles touched by the batch
+   uint loggersSize = 0, written = 0, dropped = 0;
+
+   while (true) {
+      LOG_RECORD &record = g_logQueue[g_logQueueHead & (LOG_QUEUE_SIZE-1)];
+      if (record.sequence != g_logQueueHead+1) break;                // the next entry is not yet published
+
+      LogFile* logger = record.logger;
+      logger->lock();                                                // no other thread opens or closes the logfile
+      if (logger->append(record.data, record.size)) {                // may start a new segment
+         if (record.preamble) logger->addPreamble(record.data, record.size);
+      }
+      else if (record.size) dropped++;
+      logger->unlock();
+      if (record.data != record.text) free(record.data);
+
+      uint i = 0;
+      while (i < loggersSize && loggers[i] != logger) i++;
+      if (i == loggersSize) {
+         if (loggersSize == 32) LogWriter_FlushLoggers(loggers, loggersSize);   // flush early if too many logfiles are touched
+         loggers[loggersSize++] = logger;
+      }
+
+      InterlockedExchange(&record.sequence, g_logQueueHead + LOG_QUEUE_SIZE);  // release the slot to producers
+      g_logQueueHead++;
+      written++;
+   }
+
+   LogWriter_FlushLoggers(loggers, loggersSize);
+   if (dropped) warn(ERR_RUNTIME_ERROR, "%d log entries dropped (logfile closed)", dropped);
+   return(written);
+}
+
+
+/**
+ * Entry point of the writer thread. Wakes up in regular intervals or if signaled and writes the queued entries in batches.
+ * The thread holds a reference to the DLL, so the DLL can't be unloaded while the thread is running. It's stopped when the
+ * last live MQL program was reclaimed, see LogWriter_StopIdle(), or by ShutdownLogWriter().
+ *
+ * @param  void* param - unused
+ *
+ * @return uint - thread exit code
+ */
+uint __stdcall LogWriter_Run(void* param) {
+   ExcludeCurrentThread();                                           // errors must not enter g_terminalMutex (lock order)
+
+   while (!g_logWriterStop) {
+      WaitForSingleObject(g_logWriterEvent, LOG_FLUSH_INTERVAL);
+
+      EnterCriticalSection(&g_logWriterMutex);
+      LogWriter_Drain();
+      LeaveCriticalSection(&g_logWriterMutex);
+   }
+   FreeLibraryAndExitThread(g_logWriterModule, 0);                   // release the DLL reference
+   return(0);
+}
+
+
+/**
+ * Initialize the log queue. The writer thread is started on first use, see LogWriter_Start(). Called only in
+ * DLL::onProcessAttach().
+ */
+void WINAPI InitLogWriter() {
+   for (uint i=0; i < LOG_QUEUE_SIZE; ++i) {
+      g_logQueue[i].sequence = i;
+   }
+   InitializeCriticalSection(&g_logWriterMutex);
+   InitializeCriticalSection(&g_logWriterControl);
+
+   g_logWriterEvent = CreateEvent(NULL, FALSE, FALSE, NULL);         // auto-reset event
+}
+
+
+/**
+ * Start the writer thread if it's not running. Called when a program opens its logfile, i.e. before the program queues
+ * entries. Must not be called from DllMain().
+ *
+ * @return BOOL - whether the writer thread is running
+ */
+BOOL WINAPI LogWriter_Start() {
+   if (g_logWriterThread) return(TRUE);
+
+   EnterCriticalSection(&g_logWriterControl);
+   if (!g_logWriterThread && !g_logWriterShutdown) {
+      if (!GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCTSTR)LogWriter_Run, &g_logWriterModule)) {
+         error(ERR_WIN32_ERROR+GetLastError(), "GetModuleHandleEx() failed, log entries are written on flush only");
+      }
+      else {
+         g_logWriterStop = FALSE;
+         g_logWriterThread = (HANDLE)_beginthreadex(NULL, 0, LogWriter_Run, NULL, 0, NULL);
+         if (!g_logWriterThread) {
+            error(ERR_WIN32_ERROR+GetLastError(), "_beginthreadex() failed, log entries are written on flush only");
+            FreeLibrary(g_logWriterModule);
+         }
+      }
+   }
+   BOOL running = (g_logWriterThread != NULL);
+   LeaveCriticalSection(&g_logWriterControl);
+   return(running);
+}
+
+
+/**
+ * Stop the writer thread, wait for it to terminate and write all remaining entries. Must be called while holding
+ * g_logWriterControl.
+ */
+void WINAPI LogWriter_Stop() {
+   HANDLE hThread = g_logWriterThread;
+   if (hThread) {
+      InterlockedExchange(&g_logWriterStop, TRUE);
+      SetEvent(g_logWriterEvent);
+      WaitForSingleObject(hThread, INFINITE);
+      g_logWriterThread = NULL;
+      CloseHandle(hThread);
+   }
+   LogWriter_Flush();
+}
+
+
+/**
+ * Stop the writer thread if no live MQL program is left, so the DLL can be unloaded (the DLL is not unloaded while the
+ * writer thread holds its reference). A program started later restarts the writer when it opens its logfile. Called by
+ * Program_Reclaim() after releasing all locks, never from DllMain(): joining the thread under the loader lock deadlocks.
+ */
+void WINAPI LogWriter_StopIdle() {
+   if (!g_logWriterThread) return;
+
+   EnterCriticalSection(&g_logWriterControl);
+   if (!Program_CountLive()) LogWriter_Stop();                       // checked under the lock: a new program waits in
+   LeaveCriticalSection(&g_logWriterControl);                        // LogWriter_Start() until the writer is stopped
+}
+
+
+/**
+ * Stop the writer thread for good, wait for it to terminate and write all remaining entries. Following entries are written
+ * on flush only. Normally not needed as the writer stops with the last live program, see LogWriter_StopIdle(). Must not be
+ * called from DllMain().
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI ShutdownLogWriter() {
+   EnterCriticalSection(&g_logWriterControl);
+   g_logWriterShutdown = TRUE;
+   LogWriter_Stop();
+   LeaveCriticalSection(&g_logWriterControl);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Write all remaining entries and release the log queue. Called only in DLL::onProcessDetach().
+ *
+ * @param  BOOL isTerminating - whether the process is terminating (all other threads are already gone)
+ */
+void WINAPI ReleaseLogWriter(BOOL isTerminating) {
+   if (isTerminating) {                                              // the writer thread is gone and may have left the mutex
+      LogWriter_Drain();                                             // abandoned, the current thread is the only consumer
+      return;
+   }
+   LogWriter_Flush();                                                // the writer thread holds a DLL reference, i.e. it was
+   if (g_logWriterThread) CloseHandle(g_logWriterThread);           // already stopped by LogWriter_StopIdle() or never ran
+   g_logWriterThread = NULL;
+   CloseHandle(g_logWriterEvent);
+   g_logWriterEvent = NULL;
+   DeleteCriticalSection(&g_logWriterControl);
+   DeleteCriticalSection(&g_logWriterMutex);
+}
+
+
+/**
+ * Queue a log entry for asynchronous writing. Entries are written in queue order, so the entries of a program keep their
+ * order. If the queue is full the call blocks until the writer thread made room. Entries fitting into a record's inline
+ * text are queued without heap allocations.
+ *
+ * @param  LogFile* logger              - target logfile (must not be closed or released before the queue was flushed)
+ * @param  char*    data                - entry text including the line break
+ * @param  uint     size                - entry size in bytes
+ * @param  BOOL     preamble [optional] - whether the entry is repeated at the start of following logfile segments
+ *                                        (default: no)
+ * @return BOOL - success status
+ */
+BOOL WINAPI LogWriter_Append(LogFile* logger, const char* data, uint size, BOOL preamble/*=FALSE*/) {
+   LOG_RECORD* record;
+   LONG position;
+
+   while (true) {
+      position = g_logQueueTail;
+      record = &g_logQueue[position & (LOG_QUEUE_SIZE-1)];
+      LONG diff = record->sequence - position;
+
+      if (!diff) {
+         if (InterlockedCompareExchange(&g_logQueueTail, position+1, position) == position) break;
+      }
+      else if (diff < 0) {                                           // the queue is full
+         SetEvent(g_logWriterEvent);
+         if (!g_logWriterThread) LogWriter_Flush();
+         Sleep(1);
+      }
+   }
+
+   record->logger   = logger;
+   record->size     = size;
+   record->preamble = preamble;
+   record->data     = record->text;
+   if (size > LOG_RECORD_TEXT) {
+      HotPath_CountAllocation();
+      record->data = (char*)malloc(size);
+      if (!record->data) {
+         record->data = record->text;
+         record->size = 0;
+         InterlockedExchange(&record->sequence, position+1);         // publish an empty entry to keep the queue going
+         return(error(ERR_OUT_OF_MEMORY, "malloc(%d) failed", size));
+      }
+   }
+   memcpy(record->data, data, size);
+   InterlockedExchange(&record->sequence, position+1);               // publish the entry
+
+   if (position - g_logQueueHead == LOG_QUEUE_SIZE/2) SetEvent(g_logWriterEvent);
+   return(TRUE);
+}
+
+
+/**
+ * Synchronously write all entries queued up to now to their logfiles and flush the logfiles. Must be called before a logfile
+ * which may have queued entries is closed or released.
+ *
+ * @return uint - number of written entries
+ */
+uint WINAPI LogWriter_Flush() {
+   LONG target = g_logQueueTail;
+   uint written = 0;
+
+   while (true) {
+      EnterCriticalSection(&g_logWriterMutex);
+      written += LogWriter_Drain();
+      BOOL done = (g_logQueueHead - target >= 0);
+      LeaveCriticalSection(&g_logWriterMutex);
+
+      if (done) break;
+      Sleep(0);                                                      // another producer is still writing a claimed slot
+   }
+   return(written);
+}
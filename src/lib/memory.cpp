@@ -1,6 +1,26 @@
 #include "expander.h"
+#include "lib/memory.h"
+#include "lib/container/SegmentedVector.h"
 #include "struct/mt4/MqlString.h"
 
+#include <algorithm>
+#include <new>
+
+
+extern CRITICAL_SECTION g_terminalMutex;                    // mutex for application-wide locking
+
+struct SCRATCH_BUFFER {                                     // a thread's preallocated scratch buffer
+   char* data;
+   uint  size;
+   uint  slot;                                              // index in g_scratchBuffers or EMPTY if not registered
+};
+SegmentedVector<SCRATCH_BUFFER*> g_scratchBuffers;          // scratch buffers of all live threads (NULL: free slot)
+volatile LONG g_freeScratchSlots;                           // number of free slots in g_scratchBuffers
+DWORD         g_scratchTls = TLS_OUT_OF_INDEXES;            // TLS slot holding the scratch buffer of the current thread
+DWORD         g_hotPathTls = TLS_OUT_OF_INDEXES;            // TLS slot holding the hot path nesting level of the current thread
+volatile LONG g_hotPathThreads;                             // number of threads currently executing a hot path
+volatile LONG g_hotPathAllocations;                         // number of heap allocations made in hot paths
+
 
 /**
  * Return the memory location of a BOOL array. Helper function to resolve addresses in MQL.
@@ -93,3 +113,179 @@ BOOL WINAPI MemCompare(const void* bufferA, const void* bufferB, uint size) {
    return(memcmp(bufferA, bufferB, size) == 0);                      // both are not NULL pointers
    #pragma EXPANDER_EXPORT
 }
+
+
+/**
+ * Initialize scratch buffers and hot path tracking. Called only in DLL::onProcessAttach().
+ */
+void WINAPI InitMemory() {
+   g_scratchTls = TlsAlloc();
+   if (g_scratchTls == TLS_OUT_OF_INDEXES) error(ERR_WIN32_ERROR+GetLastError(), "TlsAlloc()");
+   g_hotPathTls = TlsAlloc();
+   if (g_hotPathTls == TLS_OUT_OF_INDEXES) error(ERR_WIN32_ERROR+GetLastError(), "TlsAlloc()");
+}
+
+
+/**
+ * Release all scratch buffers. Called only in DLL::onProcessDetach().
+ */
+void WINAPI ReleaseMemory() {
+   for (uint i=0, size=g_scratchBuffers.size(); i < size; ++i) {
+      if (SCRATCH_BUFFER* buffer = g_scratchBuffers[i]) {
+         free(buffer->data);
+         free(buffer);
+      }
+   }
+   TlsFree(g_scratchTls);
+   TlsFree(g_hotPathTls);
+}
+
+
+/**
+ * Release the scratch buffer of the current thread. Called only in DLL::onThreadDetach() under the loader lock, so the
+ * function doesn't lock: the registry slot is cleared with an interlocked write and reused by GetScratchBuffer().
+ */
+void WINAPI ReleaseThreadScratchBuffer() {
+   SCRATCH_BUFFER* buffer = (SCRATCH_BUFFER*)TlsGetValue(g_scratchTls);
+   if (!buffer) return;
+   TlsSetValue(g_scratchTls, NULL);
+
+   if (buffer->slot != EMPTY) {
+      InterlockedExchangePointer((void**)&g_scratchBuffers[buffer->slot], NULL);
+      InterlockedIncrement(&g_freeScratchSlots);
+   }
+   free(buffer->data);
+   free(buffer);
+}
+
+
+/**
+ * Return the scratch buffer of the current thread. The buffer is allocated on first use and grows only if a larger size is
+ * requested, so in steady state the function doesn't allocate. The buffer content is valid until the thread's next call.
+ *
+ * @param  uint size - minimum buffer size in bytes
+ *
+ * @return char* - buffer or a NULL pointer in case of errors
+ */
+char* WINAPI GetScratchBuffer(uint size) {
+   SCRATCH_BUFFER* buffer = (SCRATCH_BUFFER*)TlsGetValue(g_scratchTls);
+
+   if (!buffer) {
+      HotPath_CountAllocation();
+      buffer = (SCRATCH_BUFFER*)calloc(1, sizeof(SCRATCH_BUFFER));
+      if (!buffer) return((char*)error(ERR_OUT_OF_MEMORY, "calloc(%d) failed", sizeof(SCRATCH_BUFFER)));
+
+      if (!TryEnterCriticalSection(&g_terminalMutex)) {
+         debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+         EnterCriticalSection(&g_terminalMutex);
+      }
+      buffer->slot = EMPTY;                                          // an unregistered buffer is released on thread detach only
+      for (uint i=0, n=g_scratchBuffers.size(); i < n && g_freeScratchSlots > 0; ++i) {
+         if (g_scratchBuffers[i]) continue;
+         InterlockedDecrement(&g_freeScratchSlots);                  // reuse the slot of an exited thread
+         g_scratchBuffers[i] = buffer;
+         buffer->slot = i;
+         break;
+      }
+      if (buffer->slot==EMPTY && !g_scratchBuffers.full())
+         buffer->slot = g_scratchBuffers.push_back(buffer);
+      LeaveCriticalSection(&g_terminalMutex);
+
+      TlsSetValue(g_scratchTls, buffer);
+   }
+
+   if (buffer->size < size) {
+      uint newSize = std::max(size, std::max(buffer->size*2, (uint)SCRATCH_BUFFER_SIZE));
+      HotPath_CountAllocation();
+      char* data = (char*)realloc(buffer->data, newSize);
+      if (!data) return((char*)error(ERR_OUT_OF_MEMORY, "realloc(%d) failed", newSize));
+      buffer->data = data;
+      buffer->size = newSize;
+   }
+   return(buffer->data);
+}
+
+
+/**
+ * Mark the begin of an allocation-free hot path in the current thread. Hot paths may be nested.
+ */
+void WINAPI HotPath_Enter() {
+   uint level = (uint)TlsGetValue(g_hotPathTls) + 1;
+   TlsSetValue(g_hotPathTls, (void*)level);
+   if (level == 1) InterlockedIncrement(&g_hotPathThreads);
+}
+
+
+/**
+ * Mark the end of an allocation-free hot path in the current thread.
+ */
+void WINAPI HotPath_Leave() {
+   uint level = (uint)TlsGetValue(g_hotPathTls);
+   if (!level) return;
+   TlsSetValue(g_hotPathTls, (void*)--level);
+   if (!level) InterlockedDecrement(&g_hotPathThreads);
+}
+
+
+/**
+ * Count a heap allocation if the current thread executes a hot path. Called by the global operator new and by all other
+ * allocating helpers reachable from a hot path. Doesn't modify the thread's last error.
+ */
+void WINAPI HotPath_CountAllocation() {
+   if (!g_hotPathThreads || g_hotPathTls==TLS_OUT_OF_INDEXES) return;
+
+   DWORD lastError = GetLastError();
+   BOOL isHotPath = (TlsGetValue(g_hotPathTls) != NULL);
+   SetLastError(lastError);
+
+   if (isHotPath) InterlockedIncrement(&g_hotPathAllocations);
+}
+
+
+/**
+ * Return the number of heap allocations made in hot paths (i.e. in SyncMainContext_start() and in the logging functions)
+ * since the DLL was loaded or the counter was reset. In steady state the counter must not increase.
+ *
+ * @return uint
+ */
+uint WINAPI GetHotPathAllocations() {
+   return(g_hotPathAllocations);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Reset the counter of heap allocations made in hot paths.
+ *
+ * @return uint - the previous counter value
+ */
+uint WINAPI ResetHotPathAllocations() {
+   return(InterlockedExchange(&g_hotPathAllocations, 0));
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Global operator new and operator delete. Replaced to count heap allocations in hot paths.
+ */
+void* operator new(size_t size) {
+   HotPath_CountAllocation();
+   void* p = malloc(size ? size : 1);
+   if (!p) throw std::bad_alloc();
+   return(p);
+}
+
+
+void* operator new[](size_t size) {
+   return(operator new(size));
+}
+
+
+void operator delete(void* p) {
+   free(p);
+}
+
+
+void operator delete[](void* p) {
+   free(p);
+}
@@ -0,0 +1,256 @@
+#include "expander.h"
+#include "lib/montecarlo.h"
+#include "lib/string.h"
+#include "struct/rsf/Order.h"
+#include "struct/rsf/Test.h"
+
+#include <algorithm>
+#include <fstream>
+#include <process.h>
+
+
+// a single Monte Carlo run shared by all worker threads
+struct MONTE_CARLO_JOB {
+   const double* trades;                              // trade results in pip
+   uint          tradesSize;                          // number of trades
+   uint          iterations;                          // number of iterations to run
+   DWORD         flags;                               // resampling flags: MC_SHUFFLE | MC_BOOTSTRAP | MC_SKIP_TRADES | MC_SLIPPAGE
+   double        skipRatio;                           // probability of a trade to be skipped
+   double        slippage;                            // max. slippage per trade in pip
+   volatile LONG nextIteration;                       // work counter: the next iteration to run
+   double*       drawdowns;                           // max. drawdown per iteration (each slot is written by a single worker)
+   double*       equities;                            // final equity per iteration (each slot is written by a single worker)
+};
+
+
+// per-thread worker data
+struct MONTE_CARLO_WORKER {
+   MONTE_CARLO_JOB* job;
+   uint64           random;                           // state of the worker's random number generator (xorshift64*)
+};
+
+
+/**
+ * Return the next random number of a xorshift64* generator.
+ *
+ * @param  uint64 &state - generator state (must not be 0)
+ *
+ * @return uint64
+ */
+uint64 WINAPI MonteCarlo_Random(uint64 &state) {
+   state ^= state >> 12;
+   state ^= state << 25;
+   state ^= state >> 27;
+   return(state * 2685821657736338717ULL);
+}
+
+
+/**
+ * Return a uniformly distributed random number in the range [0, 1).
+ *
+ * @param  uint64 &state - generator state
+ *
+ * @return double
+ */
+double WINAPI MonteCarlo_Uniform(uint64 &state) {
+   return((MonteCarlo_Random(state) >> 11) * (1./9007199254740992.));      // 53 bit mantissa / 2^53
+}
+
+
+/**
+ * Thread function of a Monte Carlo worker. Workers fetch iterations via an atomic counter and write the results of each
+ * iteration to the iteration's own slot in the result arrays. No locking is needed.
+ *
+ * @param  void* arg - MONTE_CARLO_WORKER* of the thread
+ *
+ * @return uint - thread exit code
+ */
+uint __stdcall MonteCarlo_Worker(void* arg) {
+   MONTE_CARLO_WORKER* worker = (MONTE_CARLO_WORKER*)arg;
+   MONTE_CARLO_JOB*    job    = worker->job;
+   uint64             &random = worker->random;
+
+   uint   size      = job->tradesSize;
+   BOOL   shuffle   = job->flags & MC_SHUFFLE;
+   BOOL   bootstrap = job->flags & MC_BOOTSTRAP;
+   double skipRatio = (job->flags & MC_SKIP_TRADES) ? job->skipRatio : 0;
+   double slippage  = (job->flags & MC_SLIPPAGE)    ? job->slippage  : 0;
+
+   std::vector<double> sequence(job->trades, job->trades + size);        // per-thread copy of the trade sequence
+   LONG i;
+
+   while ((i = InterlockedIncrement(&job->nextIteration) - 1) < (LONG)job->iterations) {
+      if (shuffle) {
+         for (uint n=size-1; n > 0; --n) {                                 // Fisher-Yates
+            std::swap(sequence[n], sequence[(uint)(MonteCarlo_Uniform(random) * (n+1))]);
+         }
+      }
+      double equity = 0, peak = 0, drawdown = 0;
+
+      for (uint n=0; n < size; ++n) {
+         double pl = bootstrap ? job->trades[(uint)(MonteCarlo_Uniform(random) * size)] : sequence[n];
+         if (skipRatio && MonteCarlo_Uniform(random) < skipRatio) continue;
+         if (slippage) pl -= MonteCarlo_Uniform(random) * slippage;
+
+         equity += pl;
+         if      (equity > peak)             peak     = equity;
+         else if (peak - equity > drawdown)  drawdown = peak - equity;
+      }
+      job->drawdowns[i] = drawdown;
+      job->equities [i] = equity;
+   }
+   return(0);
+}
+
+
+/**
+ * Run a Monte Carlo analysis on a sequence of trade results using all available processor cores.
+ *
+ * @param  vector<double>      &trades     - trade results in pip
+ * @param  uint                iterations  - number of iterations
+ * @param  DWORD               flags       - resampling flags: MC_SHUFFLE | MC_BOOTSTRAP (mutually exclusive), MC_SKIP_TRADES,
+ *                                           MC_SLIPPAGE
+ * @param  double              skipRatio   - probability of a trade to be skipped (MC_SKIP_TRADES only)
+ * @param  double              slippage    - max. slippage per trade in pip, uniformly distributed (MC_SLIPPAGE only)
+ * @param  double              confidence  - confidence level of the calculated intervals, e.g. 0.95
+ * @param  MONTE_CARLO_RESULT* result      - struct receiving the results
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI MonteCarlo_Run(const std::vector<double> &trades, uint iterations, DWORD flags, double skipRatio, double slippage, double confidence, MONTE_CARLO_RESULT* result) {
+   if ((int)iterations <= 0)                           return(error(ERR_INVALID_PARAMETER, "invalid parameter iterations: %d", (int)iterations));
+   if (flags & MC_SHUFFLE && flags & MC_BOOTSTRAP)     return(error(ERR_INVALID_PARAMETER, "invalid parameter flags: combination of MC_SHUFFLE & MC_BOOTSTRAP"));
+   if (skipRatio < 0 || skipRatio >= 1)                return(error(ERR_INVALID_PARAMETER, "invalid parameter skipRatio: %f (must be in the range [0, 1))", skipRatio));
+   if (slippage < 0)                                   return(error(ERR_INVALID_PARAMETER, "invalid parameter slippage: %f (negative)", slippage));
+   if (confidence <= 0 || confidence >= 1)             return(error(ERR_INVALID_PARAMETER, "invalid parameter confidence: %f (must be in the range (0, 1))", confidence));
+   if ((uint)result < MIN_VALID_POINTER)               return(error(ERR_INVALID_PARAMETER, "invalid parameter result: 0x%p (not a valid pointer)", result));
+   if (trades.empty())                                 return(error(ERR_INVALID_PARAMETER, "invalid parameter trades: no trades"));
+
+   std::vector<double> drawdowns(iterations), equities(iterations);
+
+   MONTE_CARLO_JOB job = {};
+   job.trades        = &trades[0];
+   job.tradesSize    = trades.size();
+   job.iterations    = iterations;
+   job.flags         = flags;
+   job.skipRatio     = skipRatio;
+   job.slippage      = slippage;
+   job.nextIteration = 0;
+   job.drawdowns     = &drawdowns[0];
+   job.equities      = &equities[0];
+
+   // start one worker per processor core (WaitForMultipleObjects() supports max. 64 handles)
+   SYSTEM_INFO si;
+   GetSystemInfo(&si);
+   uint threads = std::min(std::min((uint)si.dwNumberOfProcessors, (uint)MAXIMUM_WAIT_OBJECTS), iterations);
+
+   std::vector<MONTE_CARLO_WORKER> workers(threads);
+   std::vector<HANDLE>             handles;
+   uint64 seed = ((uint64)GetTickCount() << 32) ^ GetCurrentThreadId() ^ (uint)&job;
+
+   for (uint i=0; i < threads; ++i) {
+      workers[i].job    = &job;
+      workers[i].random = (seed + (i+1) * 0x9E3779B97F4A7C15ULL) | 1;    // distinct non-zero seeds
+      HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, MonteCarlo_Worker, &workers[i], 0, NULL);
+      if (!hThread) {
+         error(ERR_WIN32_ERROR+GetLastError(), "_beginthreadex() failed for worker %d of %d (continuing with %d workers)", i+1, threads, handles.size());
+         break;
+      }
+      handles.push_back(hThread);
+   }
+   if (handles.empty()) {
+      MonteCarlo_Worker(&workers[0]);                                      // run in the current thread
+   }
+   else {
+      WaitForMultipleObjects(handles.size(), &handles[0], TRUE, INFINITE);
+      for (uint i=0; i < handles.size(); ++i) CloseHandle(handles[i]);
+   }
+
+   // reduce the results
+   std::sort(drawdowns.begin(), drawdowns.end());
+   std::sort(equities .begin(), equities .end());
+
+   uint last   = iterations - 1;
+   uint lower  = (uint)((1 - confidence)/2 * last);
+   uint upper  = last - lower;
+   uint median = last/2;
+
+   result->drawdownLower  = drawdowns[lower ];
+   result->drawdownMedian = drawdowns[median];
+   result->drawdownUpper  = drawdowns[upper ];
+   result->equityLower    = equities [lower ];
+   result->equityMedian   = equities [median];
+   result->equityUpper    = equities [upper ];
+   return(TRUE);
+}
+
+
+/**
+ * Run a Monte Carlo analysis on the closed trades of a test. Can be called after Test_StopReporting().
+ *
+ * @param  EXECUTION_CONTEXT*  ec         - execution context of the tested expert
+ * @param  uint                iterations - number of iterations
+ * @param  DWORD               flags      - resampling flags: MC_SHUFFLE | MC_BOOTSTRAP (mutually exclusive), MC_SKIP_TRADES,
+ *                                          MC_SLIPPAGE
+ * @param  double              skipRatio  - probability of a trade to be skipped (MC_SKIP_TRADES only)
+ * @param  double              slippage   - max. slippage per trade in pip (MC_SLIPPAGE only)
+ * @param  double              confidence - confidence level of the calculated intervals, e.g. 0.95
+ * @param  MONTE_CARLO_RESULT* result     - struct receiving the results (MQL: double[6])
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI Test_MonteCarlo(const EXECUTION_CONTEXT* ec, uint iterations, DWORD flags, double skipRatio, double slippage, double confidence, MONTE_CARLO_RESULT* result) {
+   if ((uint)ec < MIN_VALID_POINTER)            return(error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec));
+   if (ec->programType!=PT_EXPERT || !ec->test) return(error(ERR_FUNC_NOT_ALLOWED, "function allowed only in experts under test"));
+   if (!ec->test->closedPositions)              return(error(ERR_RUNTIME_ERROR, "invalid OrderList initialization, test.closedPositions: NULL"));
+
+   OrderList &positions = *ec->test->closedPositions;
+   uint size = positions.size();
+
+   std::vector<double> trades;
+   trades.reserve(size);
+   for (uint i=0; i < size; ++i) {
+      trades.push_back(positions[i]->plPip);
+   }
+   return(MonteCarlo_Run(trades, iterations, flags, skipRatio, slippage, confidence, result));
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Run a Monte Carlo analysis on the trades of a test report saved by Test_SaveReport().
+ *
+ * @param  char*               filename   - full filename of the test report
+ * @param  uint                iterations - number of iterations
+ * @param  DWORD               flags      - resampling flags: MC_SHUFFLE | MC_BOOTSTRAP (mutually exclusive), MC_SKIP_TRADES,
+ *                                          MC_SLIPPAGE
+ * @param  double              skipRatio  - probability of a trade to be skipped (MC_SKIP_TRADES only)
+ * @param  double              slippage   - max. slippage per trade in pip (MC_SLIPPAGE only)
+ * @param  double              confidence - confidence level of the calculated intervals, e.g. 0.95
+ * @param  MONTE_CARLO_RESULT* result     - struct receiving the results (MQL: double[6])
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI Test_MonteCarloFromReport(const char* filename, uint iterations, DWORD flags, double skipRatio, double slippage, double confidence, MONTE_CARLO_RESULT* result) {
+   if ((uint)filename < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter filename: 0x%p (not a valid pointer)", filename));
+   if (!*filename)                         return(error(ERR_INVALID_PARAMETER, "invalid parameter filename: \"\" (empty)"));
+
+   std::ifstream file(filename);
+   if (!file.is_open()) return(error(ERR_WIN32_ERROR+GetLastError(), "cannot open file \"%s\" (%s)", filename, strerror(errno)));
+
+   // report lines: order.{i}={id=1, ticket=2, ..., result=12.3}
+   std::vector<double> trades;
+   trades.reserve(1024);
+   string line, key = ", result=";
+
+   while (std::getline(file, line)) {
+      if (!StrStartsWith(line.c_str(), "order.")) continue;
+      size_t pos = line.rfind(key);
+      if (pos == string::npos) return(error(ERR_RUNTIME_ERROR, "unexpected line in file \"%s\": %s", filename, line.c_str()));
+      trades.push_back(atof(line.c_str() + pos + key.length()));
+   }
+   file.close();
+
+   return(MonteCarlo_Run(trades, iterations, flags, skipRatio, slippage, confidence, result));
+   #pragma EXPANDER_EXPORT
+}
@@ -0,0 +1,315 @@
+#include "expander.h"
+#include "lib/executioncontext.h"
+#include "lib/profiler.h"
+#include "struct/rsf/ExecutionContext.h"
+
+#include <algorithm>
+
+
+extern CRITICAL_SECTION          g_terminalMutex;            // mutex for application-wide locking
+extern MqlProgramList            g_mqlPrograms;              // all MQL programs: vector<ContextChain*> with index = program id
+
+DWORD                            g_profilerTls = TLS_OUT_OF_INDEXES;    // TLS slot holding the profile of the current thread
+SegmentedVector<THREAD_PROFILE*> g_threadProfiles;           // profiles of all threads executing MQL programs
+double                           g_counterTicksPerUsec = 1;  // performance counter frequency in ticks per microsecond
+volatile LONG                    g_profilerDumpInterval;     // interval of periodic dumps in seconds (0: no periodic dumps)
+volatile LONG                    g_profilerNextDump;         // GetTickCount() value of the next periodic dump
+
+const char* g_probeNames[LATENCY_PROBES] = {
+   "SyncMainContext_init",
+   "SyncMainContext_start",
+   "SyncMainContext_deinit",
+   "SyncLibContext_init",
+   "SyncLibContext_deinit",
+   "LeaveContext",
+   "AppendLogMessageA",
+};
+
+
+/**
+ * Initialize the profiler. Called only in DLL::onProcessAttach().
+ */
+void WINAPI InitProfiler() {
+   g_profilerTls = TlsAlloc();
+   if (g_profilerTls == TLS_OUT_OF_INDEXES) error(ERR_WIN32_ERROR+GetLastError(), "TlsAlloc()");
+
+   LARGE_INTEGER frequency;
+   if (QueryPerformanceFrequency(&frequency) && frequency.QuadPart > 0)
+      g_counterTicksPerUsec = frequency.QuadPart / 1000000.;
+}
+
+
+/**
+ * Release all profiles. Called only in DLL::onProcessDetach().
+ */
+void WINAPI ReleaseProfiler() {
+   for (uint i=0, size=g_threadProfiles.size(); i < size; ++i) {
+      THREAD_PROFILE* thread = g_threadProfiles[i];
+      for (uint pid=0, programs=thread->programs.size(); pid < programs; ++pid) {
+         delete thread->programs[pid];
+      }
+      delete thread;
+   }
+   TlsFree(g_profilerTls);
+}
+
+
+/**
+ * Return the profile of the current thread. On first use the profile is created and registered.
+ *
+ * @return THREAD_PROFILE*
+ */
+THREAD_PROFILE* WINAPI Profiler_GetThreadProfile() {
+   THREAD_PROFILE* thread = (THREAD_PROFILE*)TlsGetValue(g_profilerTls);
+
+   if (!thread) {
+      thread = new THREAD_PROFILE();
+      thread->threadId = GetCurrentThreadId();
+
+      if (!TryEnterCriticalSection(&g_terminalMutex)) {
+         debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+         EnterCriticalSection(&g_terminalMutex);
+      }
+      g_threadProfiles.push_back(thread);
+      LeaveCriticalSection(&g_terminalMutex);
+
+      TlsSetValue(g_profilerTls, thread);
+   }
+   return(thread);
+}
+
+
+/**
+ * Return the current value of the performance counter.
+ *
+ * @return LONGLONG
+ */
+LONGLONG WINAPI Profiler_StartCounter() {
+   LARGE_INTEGER counter;
+   QueryPerformanceCounter(&counter);
+   return(counter.QuadPart);
+}
+
+
+/**
+ * Record the latency of a probe in the current thread's profile. Called on every probed DLL call, so the function doesn't
+ * lock: the thread profile is written by the owning thread only.
+ *
+ * @param  int      probe        - probe id
+ * @param  uint     pid          - program id or NULL to use the program last executed by the current thread
+ * @param  LONGLONG startCounter - performance counter at probe start
+ */
+void WINAPI Profiler_Record(int probe, uint pid, LONGLONG startCounter) {
+   LARGE_INTEGER counter;
+   QueryPerformanceCounter(&counter);
+
+   if ((uint)probe >= LATENCY_PROBES) return;
+   if (!pid && !(pid=GetLastThreadProgram())) return;
+
+   SegmentedVector<PROGRAM_PROFILE*> &programs = Profiler_GetThreadProfile()->programs;
+   while (programs.size() <= pid) {
+      if (programs.full()) return;                                   // pids beyond the capacity are silently not profiled
+      programs.push_back(NULL);
+   }
+   PROGRAM_PROFILE* profile = programs[pid];
+   if (!profile) profile = programs[pid] = new PROGRAM_PROFILE();
+
+   uint latency = (uint)((counter.QuadPart - startCounter) / g_counterTicksPerUsec);
+   profile->calls    [probe]++;
+   profile->totalTime[probe] += latency;
+   if (latency > profile->maxTime[probe]) profile->maxTime[probe] = latency;
+   profile->histogram[probe][Profiler_GetBucket(latency)]++;
+
+   // periodic dump: the first thread seeing the due time performs the dump
+   if (probe==PROBE_SYNCMAINCONTEXT_START && g_profilerDumpInterval) {
+      LONG now = GetTickCount(), nextDump = g_profilerNextDump;
+      if (now - nextDump >= 0) {
+         if (InterlockedCompareExchange(&g_profilerNextDump, now + g_profilerDumpInterval*1000, nextDump) == nextDump)
+            Profiler_Dump();
+      }
+   }
+}
+
+
+/**
+ * Release the profiles of a reclaimed MQL program in all threads. Called only by Program_Reclaim(). The program is quiescent,
+ * no thread records latencies for it anymore.
+ *
+ * @param  uint pid - program id
+ */
+void WINAPI Profiler_ReleaseProgram(uint pid) {
+   if (!TryEnterCriticalSection(&g_terminalMutex)) {
+      debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+      EnterCriticalSection(&g_terminalMutex);
+   }
+   for (uint i=0, size=g_threadProfiles.size(); i < size; ++i) {
+      THREAD_PROFILE* thread = g_threadProfiles[i];
+      if (thread->programs.size() <= pid) continue;
+
+      PROGRAM_PROFILE* profile = thread->programs[pid];
+      thread->programs[pid] = NULL;
+      delete profile;
+   }
+   LeaveCriticalSection(&g_terminalMutex);
+}
+
+
+/**
+ * Return the histogram bucket of a latency. Buckets are log-linear: values below 4 have a bucket of their own, larger values
+ * are split into 4 buckets per power of 2.
+ *
+ * @param  uint latency - latency in microseconds
+ *
+ * @return uint - bucket index
+ */
+uint WINAPI Profiler_GetBucket(uint latency) {
+   if (latency < 4) return(latency);
+
+   uint exponent = 2;                                                // index of the highest set bit
+   while (latency >> (exponent+1)) exponent++;
+
+   uint bucket = 4*(exponent-1) + ((latency >> (exponent-2)) & 3);
+   return(std::min(bucket, (uint)LATENCY_BUCKETS-1));
+}
+
+
+/**
+ * Return the upper limit of a histogram bucket.
+ *
+ * @param  int bucket - bucket index
+ *
+ * @return uint - latency in microseconds (exclusive) or NULL in case of errors
+ */
+uint WINAPI Profiler_GetBucketLimit(int bucket) {
+   if ((uint)bucket >= LATENCY_BUCKETS) return(_NULL(error(ERR_INVALID_PARAMETER, "invalid parameter bucket: %d (out of range)", bucket)));
+   if (bucket < 4) return(bucket + 1);
+
+   uint exponent = bucket/4 + 1;
+   return((5 + bucket%4) << (exponent-2));
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return the latency histogram of a probe for an MQL program (all threads).
+ *
+ * @param  uint pid     - program id
+ * @param  int  probe   - probe id: PROBE_SYNCMAINCONTEXT_INIT...PROBE_APPENDLOGMESSAGE
+ * @param  uint buckets - array receiving the bucket counts, see Profiler_GetBucketLimit()
+ * @param  int  size    - size of the passed array (may be 0 to query the number of calls only)
+ *
+ * @return int - number of recorded calls or EMPTY (-1) in case of errors
+ */
+int WINAPI Profiler_GetHistogram(uint pid, int probe, uint buckets[], int size) {
+   if ((uint)probe >= LATENCY_PROBES)             return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter probe: %d (not a probe id)", probe)));
+   if (size < 0)                                  return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size: %d", size)));
+   if (size && (uint)buckets < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter buckets: 0x%p (not a valid pointer)", buckets)));
+
+   size = std::min(size, LATENCY_BUCKETS);
+   for (int i=0; i < size; ++i) buckets[i] = 0;
+   uint calls = 0;
+
+   if (!TryEnterCriticalSection(&g_terminalMutex)) {                // profiles of reclaimed programs are released
+      debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+      EnterCriticalSection(&g_terminalMutex);
+   }
+   for (uint i=0, threads=g_threadProfiles.size(); i < threads; ++i) {
+      const THREAD_PROFILE* thread = g_threadProfiles[i];
+      if (thread->programs.size() <= pid) continue;
+
+      if (const PROGRAM_PROFILE* profile = thread->programs[pid]) {
+         calls += profile->calls[probe];
+         for (int n=0; n < size; ++n) buckets[n] += profile->histogram[probe][n];
+      }
+   }
+   LeaveCriticalSection(&g_terminalMutex);
+   return(calls);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return latency statistics of a probe for an MQL program (all threads). Percentiles are resolved to the upper limit of the
+ * histogram bucket they fall into.
+ *
+ * @param  uint   pid   - program id
+ * @param  int    probe - probe id: PROBE_SYNCMAINCONTEXT_INIT...PROBE_APPENDLOGMESSAGE
+ * @param  double stats - array receiving the number of calls and the average, median, 99th percentile and max. latency in
+ *                        microseconds (MQL: double[5])
+ * @return BOOL - success status
+ */
+BOOL WINAPI Profiler_GetStats(uint pid, int probe, double stats[]) {
+   if ((uint)probe >= LATENCY_PROBES)   return(error(ERR_INVALID_PARAMETER, "invalid parameter probe: %d (not a probe id)", probe));
+   if ((uint)stats < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter stats: 0x%p (not a valid pointer)", stats));
+
+   uint buckets[LATENCY_BUCKETS], maxTime = 0;
+   uint64 totalTime = 0;
+   uint calls = Profiler_GetHistogram(pid, probe, buckets, LATENCY_BUCKETS);
+
+   if (!TryEnterCriticalSection(&g_terminalMutex)) {
+      debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+      EnterCriticalSection(&g_terminalMutex);
+   }
+   for (uint i=0, threads=g_threadProfiles.size(); i < threads; ++i) {
+      const THREAD_PROFILE* thread = g_threadProfiles[i];
+      if (thread->programs.size() <= pid) continue;
+
+      if (const PROGRAM_PROFILE* profile = thread->programs[pid]) {
+         totalTime += profile->totalTime[probe];
+         maxTime = std::max(maxTime, profile->maxTime[probe]);
+      }
+   }
+   LeaveCriticalSection(&g_terminalMutex);
+
+   double median = 0, p99 = 0;
+   for (uint i=0, count=0; i < LATENCY_BUCKETS && calls; ++i) {
+      count += buckets[i];
+      if (!median && count >= calls*0.5)  median = Profiler_GetBucketLimit(i);
+      if (!p99    && count >= calls*0.99) p99    = Profiler_GetBucketLimit(i);
+   }
+
+   stats[0] = calls;
+   stats[1] = calls ? (double)totalTime/calls : 0;
+   stats[2] = median;
+   stats[3] = p99;
+   stats[4] = maxTime;
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Set the interval of periodic profile dumps to the debug output. Dumps are triggered by SyncMainContext_start().
+ *
+ * @param  uint seconds - dump interval in seconds (0: no periodic dumps)
+ *
+ * @return uint - the previous interval
+ */
+uint WINAPI Profiler_SetDumpInterval(uint seconds) {
+   g_profilerNextDump = GetTickCount() + seconds*1000;
+   return(InterlockedExchange(&g_profilerDumpInterval, seconds));
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Dump the latency statistics of all profiled MQL programs to the debug output.
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI Profiler_Dump() {
+   uint programs = g_mqlPrograms.size();
+   double stats[5];
+
+   for (uint pid=1; pid < programs; ++pid) {                         // index[0] is always empty
+      const EXECUTION_CONTEXT* master = (*g_mqlPrograms[pid])[0];
+
+      for (int probe=0; probe < LATENCY_PROBES; ++probe) {
+         if (!Profiler_GetStats(pid, probe, stats)) return(FALSE);
+         if (!stats[0]) continue;
+         notice("pid=%d %s  %-22s  calls=%.0f  avg=%.1f  p50<%.0f  p99<%.0f  max=%.0f usec", pid, (master ? master->programName : ""), g_probeNames[probe], stats[0], stats[1], stats[2], stats[3], stats[4]);
+      }
+   }
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
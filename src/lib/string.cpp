@@ -1,4 +1,5 @@
 #include "expander.h"
+#include "lib/memory.h"
 #include "lib/string.h"
 #include "struct/mt4/MqlString.h"
 
@@ -198,6 +199,7 @@ BOOL WINAPI SortMqlStringsW(MqlStringW strings[], int size) {
  * Write formatted data to a string similar to sprintf() and return the resulting string. This function is identical to
  * strformat() but registers the allocated memory for the returned string at the internal memory manager. The memory manager
  * will release the memory at a time of its choice but the earliest at the next tick of the currently executed MQL program.
+ * In a hot path the allocation is counted by strformat(), see HotPath_CountAllocation().
  *
  * @param  char* format - string with format codes
  * @param        ...    - variable number of additional arguments
@@ -731,6 +733,7 @@ char* strformat(const char* format, const va_list &args) {
    if (!*format) return((char*)error(ERR_INVALID_PARAMETER, "invalid parameter format: \"\" (empty)"));
 
    uint size = _vscprintf(format, args) + 1;                // +1 for the terminating '\0'
+   HotPath_CountAllocation();
    char* buffer = (char*)malloc(size);
    vsprintf_s(buffer, size, format, args);
 
@@ -1,4 +1,6 @@
+#define DIAG_MODULE DIAG_TESTER
 #include "expander.h"
+#include "lib/accounting.h"
 #include "lib/conversion.h"
 #include "lib/file.h"
 #include "lib/datetime.h"
@@ -223,12 +225,14 @@ const FXT_HEADER* WINAPI Tester_ReadFxtHeader(const char* symbol, uint timeframe
    file.read((char*)fxt, sizeof(FXT_HEADER));
    file.close(); if (file.fail()) return((FXT_HEADER*)error(ERR_WIN32_ERROR+GetLastError(), "cannot read %d bytes from file \"%s\"", sizeof(FXT_HEADER), fxtFile.c_str()));
 
+   CheckAccountingModes(fxt);                                        // warn once per test
    return(fxt);
 }
 
 
 /**
- * Get the commission value for the specified lotsize.
+ * Get the commission for the specified lotsize according to the symbol's commission settings. As before the value is
+ * returned as configured (per round-turn or per single deal), it's not doubled for COMMISSION_PER_DEAL.
  *
  * @param  EXECUTION_CONTEXT* ec              - execution context of the tested expert
  * @param  double             lots [optional] - lotsize to calculate commission for (default: 1 lot)
@@ -245,9 +249,7 @@ double WINAPI Test_GetCommission(const EXECUTION_CONTEXT* ec, double lots/*=1.0*
    const FXT_HEADER* fxt = test->fxtHeader;
    if (!fxt) return(EMPTY);
 
-   if (lots == 1)
-      return(fxt->commissionValue);
-   return(fxt->commissionValue * lots);
+   return(CalculateCommission(fxt, lots, ec->bid));
    #pragma EXPANDER_EXPORT
 }
 
@@ -282,7 +284,9 @@ BOOL WINAPI Test_onPositionOpen(const EXECUTION_CONTEXT* ec, int ticket, int typ
       strcpy(order->comment, comment);
 
       order->high          = ec->bid;
+      order->highTime      = openTime;
       order->low           = ec->bid;
+      order->lowTime       = openTime;
    positions->push_back(order);
 
    if (order->type == OP_LONG)  longPositions->push_back(order);
@@ -325,15 +329,20 @@ BOOL WINAPI Test_onPositionClose(const EXECUTION_CONTEXT* ec, int ticket, double
 
          // update/calculate metrics
          if (order->type == OP_LONG) {
-            order->runupPip    = round((order->high - order->openPrice)/ec->pip, 1);
-            order->drawdownPip = round((order->low  - order->openPrice)/ec->pip, 1);
-            order->plPip       = round((order->closePrice - order->openPrice)/ec->pip, 1);
+            order->runupPip     = round((order->high - order->openPrice)/ec->pip, 1);
+            order->runupTime    = order->highTime;
+            order->drawdownPip  = round((order->low  - order->openPrice)/ec->pip, 1);
+            order->drawdownTime = order->lowTime;
+            order->plPip        = round((order->closePrice - order->openPrice)/ec->pip, 1);
          }
          else {
-            order->runupPip    = round((order->openPrice - order->low )/ec->pip, 1);
-            order->drawdownPip = round((order->openPrice - order->high)/ec->pip, 1);
-            order->plPip       = round((order->openPrice - order->closePrice)/ec->pip, 1);
+            order->runupPip     = round((order->openPrice - order->low )/ec->pip, 1);
+            order->runupTime    = order->lowTime;
+            order->drawdownPip  = round((order->openPrice - order->high)/ec->pip, 1);
+            order->drawdownTime = order->highTime;
+            order->plPip        = round((order->openPrice - order->closePrice)/ec->pip, 1);
          }
+         order->retracePip = round(order->retrace/ec->pip, 1);
 
          // move the order to closed positions
          openPositions.erase(openPositions.begin() + i);             // drop open position
@@ -364,6 +373,18 @@ BOOL WINAPI Test_onPositionClose(const EXECUTION_CONTEXT* ec, int ticket, double
             ec->test->closedShortPositions->push_back(order);        // add it to closed short positions
          }
 
+         // update the closed position indexes
+         TEST* test = ec->test;
+         ORDER_HISTORY_add(test->closedHistory, order);
+
+         ORDER_HISTORY* &byMagic = (*test->closedHistoryByMagic)[order->magicNumber];
+         if (!byMagic) byMagic = new ORDER_HISTORY();
+         ORDER_HISTORY_add(byMagic, order);
+
+         ORDER_HISTORY* &bySymbol = (*test->closedHistoryBySymbol)[order->symbol];
+         if (!bySymbol) bySymbol = new ORDER_HISTORY();
+         ORDER_HISTORY_add(bySymbol, order);
+
          debug("position closed:  %s", ORDER_toStr(order));
          break;
       }
@@ -375,6 +396,150 @@ BOOL WINAPI Test_onPositionClose(const EXECUTION_CONTEXT* ec, int ticket, double
 }
 
 
+/**
+ * Get the number of positions of a test closed in the specified time range.
+ *
+ * @param  EXECUTION_CONTEXT* ec   - execution context of the tested expert
+ * @param  datetime           from - start of the range (inclusive)
+ * @param  datetime           to   - end of the range (inclusive) or NULL (0) for no upper limit
+ *
+ * @return int - number of closed positions or EMPTY (-1) in case of errors
+ */
+int WINAPI Test_GetClosedTrades(const EXECUTION_CONTEXT* ec, datetime from, datetime to) {
+   if ((uint)ec < MIN_VALID_POINTER)            return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
+   if (ec->programType!=PT_EXPERT || !ec->test) return(_EMPTY(error(ERR_FUNC_NOT_ALLOWED, "function allowed only in experts under test")));
+   if (!ec->test->closedHistory)                return(_EMPTY(error(ERR_RUNTIME_ERROR, "invalid ORDER_HISTORY initialization, test.closedHistory: NULL")));
+
+   return(ORDER_HISTORY_query(ec->test->closedHistory, from, to));
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Get the number of positions of a test with the specified magic number closed in the specified time range.
+ *
+ * @param  EXECUTION_CONTEXT* ec          - execution context of the tested expert
+ * @param  int                magicNumber - magic number of the positions
+ * @param  datetime           from        - start of the range (inclusive)
+ * @param  datetime           to          - end of the range (inclusive) or NULL (0) for no upper limit
+ *
+ * @return int - number of closed positions or EMPTY (-1) in case of errors
+ */
+int WINAPI Test_GetClosedTradesByMagic(const EXECUTION_CONTEXT* ec, int magicNumber, datetime from, datetime to) {
+   if ((uint)ec < MIN_VALID_POINTER)            return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
+   if (ec->programType!=PT_EXPERT || !ec->test) return(_EMPTY(error(ERR_FUNC_NOT_ALLOWED, "function allowed only in experts under test")));
+   if (!ec->test->closedHistoryByMagic)         return(_EMPTY(error(ERR_RUNTIME_ERROR, "invalid index initialization, test.closedHistoryByMagic: NULL")));
+
+   OrderHistoryByMagic &index = *ec->test->closedHistoryByMagic;
+   OrderHistoryByMagic::const_iterator it = index.find(magicNumber);
+   if (it == index.end()) return(0);
+
+   return(ORDER_HISTORY_query(it->second, from, to));
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Get the number of positions of a test in the specified symbol closed in the specified time range.
+ *
+ * @param  EXECUTION_CONTEXT* ec     - execution context of the tested expert
+ * @param  char*              symbol - symbol of the positions
+ * @param  datetime           from   - start of the range (inclusive)
+ * @param  datetime           to     - end of the range (inclusive) or NULL (0) for no upper limit
+ *
+ * @return int - number of closed positions or EMPTY (-1) in case of errors
+ */
+int WINAPI Test_GetClosedTradesBySymbol(const EXECUTION_CONTEXT* ec, const char* symbol, datetime from, datetime to) {
+   if ((uint)ec     < MIN_VALID_POINTER)        return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
+   if (ec->programType!=PT_EXPERT || !ec->test) return(_EMPTY(error(ERR_FUNC_NOT_ALLOWED, "function allowed only in experts under test")));
+   if ((uint)symbol < MIN_VALID_POINTER)        return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter symbol: 0x%p (not a valid pointer)", symbol)));
+   if (!ec->test->closedHistoryBySymbol)        return(_EMPTY(error(ERR_RUNTIME_ERROR, "invalid index initialization, test.closedHistoryBySymbol: NULL")));
+
+   OrderHistoryBySymbol &index = *ec->test->closedHistoryBySymbol;
+   OrderHistoryBySymbol::const_iterator it = index.find(symbol);
+   if (it == index.end()) return(0);
+
+   return(ORDER_HISTORY_query(it->second, from, to));
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Get the net profit (profit + swap + commission) of the positions of a test closed in the specified time range.
+ *
+ * @param  EXECUTION_CONTEXT* ec   - execution context of the tested expert
+ * @param  datetime           from - start of the range (inclusive)
+ * @param  datetime           to   - end of the range (inclusive) or NULL (0) for no upper limit
+ *
+ * @return double - net profit in account currency or EMPTY_VALUE in case of errors
+ */
+double WINAPI Test_GetClosedProfit(const EXECUTION_CONTEXT* ec, datetime from, datetime to) {
+   if ((uint)ec < MIN_VALID_POINTER)            return(_EMPTY_VALUE(error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
+   if (ec->programType!=PT_EXPERT || !ec->test) return(_EMPTY_VALUE(error(ERR_FUNC_NOT_ALLOWED, "function allowed only in experts under test")));
+   if (!ec->test->closedHistory)                return(_EMPTY_VALUE(error(ERR_RUNTIME_ERROR, "invalid ORDER_HISTORY initialization, test.closedHistory: NULL")));
+
+   double profit;
+   ORDER_HISTORY_query(ec->test->closedHistory, from, to, &profit);
+   return(profit);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Get the net profit (profit + swap + commission) of the positions of a test with the specified magic number closed in the
+ * specified time range.
+ *
+ * @param  EXECUTION_CONTEXT* ec          - execution context of the tested expert
+ * @param  int                magicNumber - magic number of the positions
+ * @param  datetime           from        - start of the range (inclusive)
+ * @param  datetime           to          - end of the range (inclusive) or NULL (0) for no upper limit
+ *
+ * @return double - net profit in account currency or EMPTY_VALUE in case of errors
+ */
+double WINAPI Test_GetClosedProfitByMagic(const EXECUTION_CONTEXT* ec, int magicNumber, datetime from, datetime to) {
+   if ((uint)ec < MIN_VALID_POINTER)            return(_EMPTY_VALUE(error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
+   if (ec->programType!=PT_EXPERT || !ec->test) return(_EMPTY_VALUE(error(ERR_FUNC_NOT_ALLOWED, "function allowed only in experts under test")));
+   if (!ec->test->closedHistoryByMagic)         return(_EMPTY_VALUE(error(ERR_RUNTIME_ERROR, "invalid index initialization, test.closedHistoryByMagic: NULL")));
+
+   OrderHistoryByMagic &index = *ec->test->closedHistoryByMagic;
+   OrderHistoryByMagic::const_iterator it = index.find(magicNumber);
+   if (it == index.end()) return(0);
+
+   double profit;
+   ORDER_HISTORY_query(it->second, from, to, &profit);
+   return(profit);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Get the net profit (profit + swap + commission) of the positions of a test in the specified symbol closed in the
+ * specified time range.
+ *
+ * @param  EXECUTION_CONTEXT* ec     - execution context of the tested expert
+ * @param  char*              symbol - symbol of the positions
+ * @param  datetime           from   - start of the range (inclusive)
+ * @param  datetime           to     - end of the range (inclusive) or NULL (0) for no upper limit
+ *
+ * @return double - net profit in account currency or EMPTY_VALUE in case of errors
+ */
+double WINAPI Test_GetClosedProfitBySymbol(const EXECUTION_CONTEXT* ec, const char* symbol, datetime from, datetime to) {
+   if ((uint)ec     < MIN_VALID_POINTER)        return(_EMPTY_VALUE(error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
+   if (ec->programType!=PT_EXPERT || !ec->test) return(_EMPTY_VALUE(error(ERR_FUNC_NOT_ALLOWED, "function allowed only in experts under test")));
+   if ((uint)symbol < MIN_VALID_POINTER)        return(_EMPTY_VALUE(error(ERR_INVALID_PARAMETER, "invalid parameter symbol: 0x%p (not a valid pointer)", symbol)));
+   if (!ec->test->closedHistoryBySymbol)        return(_EMPTY_VALUE(error(ERR_RUNTIME_ERROR, "invalid index initialization, test.closedHistoryBySymbol: NULL")));
+
+   OrderHistoryBySymbol &index = *ec->test->closedHistoryBySymbol;
+   OrderHistoryBySymbol::const_iterator it = index.find(symbol);
+   if (it == index.end()) return(0);
+
+   double profit;
+   ORDER_HISTORY_query(it->second, from, to, &profit);
+   return(profit);
+   #pragma EXPANDER_EXPORT
+}
+
+
 /**
  * Save the results of a test to a logfile.
  *
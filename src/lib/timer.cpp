@@ -71,7 +71,7 @@ uint WINAPI SetupTickTimer(HWND hWnd, uint millis, DWORD flags/*=NULL*/) {
 
    // generate a new timer id and timer metadata
    if (!TryEnterCriticalSection(&g_terminalMutex)) {
-      debug("waiting to aquire lock on g_terminalMutex...");
+      debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
       EnterCriticalSection(&g_terminalMutex);
    }
    static uint lastTimerId = 0;                                // a simple counter
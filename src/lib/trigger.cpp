@@ -0,0 +1,246 @@
+#include "expander.h"
+#include "lib/executioncontext.h"
+#include "lib/trigger.h"
+
+
+extern CRITICAL_SECTION                g_terminalMutex;     // mutex for application-wide locking
+std::map<uint, TRIGGER_BOOK*>          g_triggerBooks;      // trigger books of all MQL programs with registered levels
+
+
+/**
+ * Get the trigger book of an MQL program. An existing book is looked up in the program's state without locking, only the
+ * creation of a book acquires g_terminalMutex.
+ *
+ * @param  uint pid              - MQL program id
+ * @param  BOOL create [optional] - whether to create the book if it doesn't yet exist (default: no)
+ *
+ * @return TRIGGER_BOOK* - trigger book or NULL if no book exists
+ */
+TRIGGER_BOOK* WINAPI GetTriggerBook(uint pid, BOOL create/*=FALSE*/) {
+   TRIGGER_BOOK* book = Program_GetTriggerBook(pid);
+   if (book || !create) return(book);
+
+   if (!TryEnterCriticalSection(&g_terminalMutex)) {
+      debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+      EnterCriticalSection(&g_terminalMutex);
+   }
+   std::map<uint, TRIGGER_BOOK*>::iterator it = g_triggerBooks.find(pid);
+   if (it != g_triggerBooks.end()) {
+      book = it->second;
+   }
+   else {
+      book = g_triggerBooks[pid] = new TRIGGER_BOOK();
+      book->triggered.reserve(16);
+   }
+   Program_SetTriggerBook(pid, book);
+   LeaveCriticalSection(&g_terminalMutex);
+   return(book);
+}
+
+
+/**
+ * Add a price level for a ticket to a trigger book.
+ *
+ * @param  TRIGGER_BOOK*  book
+ * @param  TriggerLevels& levels - price levels to add the level to
+ * @param  double         price  - trigger price
+ * @param  int            ticket
+ * @param  int            event  - TRIGGER_OPEN | TRIGGER_STOPLOSS | TRIGGER_TAKEPROFIT
+ */
+void WINAPI Trigger_AddLevel(TRIGGER_BOOK* book, TriggerLevels &levels, double price, int ticket, int event) {
+   TRIGGER trigger = { ticket, event };
+   TriggerLevels::iterator it = levels.insert(std::make_pair(price, trigger));
+   book->tickets[ticket].push_back(std::make_pair(&levels, it));
+}
+
+
+/**
+ * Remove all price levels of a ticket from a trigger book.
+ *
+ * @param  TRIGGER_BOOK* book
+ * @param  int           ticket
+ *
+ * @return BOOL - whether levels of the ticket have been found and removed
+ */
+BOOL WINAPI Trigger_RemoveLevels(TRIGGER_BOOK* book, int ticket) {
+   TicketIndex::iterator it = book->tickets.find(ticket);
+   if (it == book->tickets.end())
+      return(FALSE);
+
+   TicketLevels &levels = it->second;
+   for (TicketLevels::iterator level=levels.begin(), end=levels.end(); level != end; ++level) {
+      level->first->erase(level->second);
+   }
+   book->tickets.erase(it);
+   return(TRUE);
+}
+
+
+/**
+ * Register the trigger levels of an order. Existing levels of the same ticket are replaced. For positions the stoploss and
+ * takeprofit levels are registered, for pending orders the entry level. After a pending order was triggered and filled the
+ * resulting position has to be registered again.
+ *
+ * @param  EXECUTION_CONTEXT* ec         - execution context of the calling program
+ * @param  int                ticket     - order ticket
+ * @param  int                type       - order type: OP_BUY | OP_SELL | OP_BUYLIMIT | OP_SELLLIMIT | OP_BUYSTOP | OP_SELLSTOP
+ * @param  double             openPrice  - entry price of a pending order (ignored for positions)
+ * @param  double             stopLoss   - stoploss price of a position or 0 (zero) for none (ignored for pending orders)
+ * @param  double             takeProfit - takeprofit price of a position or 0 (zero) for none (ignored for pending orders)
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI Trigger_SetOrder(const EXECUTION_CONTEXT* ec, int ticket, int type, double openPrice, double stopLoss, double takeProfit) {
+   if ((uint)ec < MIN_VALID_POINTER)          return(error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec));
+   if (!ec->pid)                              return(error(ERR_INVALID_PARAMETER, "invalid execution context (ec.pid=0):  ec=%s", EXECUTION_CONTEXT_toStr(ec)));
+   if (ticket <= 0)                           return(error(ERR_INVALID_PARAMETER, "invalid parameter ticket: %d", ticket));
+   if (type < OP_BUY || type > OP_SELLSTOP)   return(error(ERR_INVALID_PARAMETER, "invalid parameter type: %d", type));
+   if (type > OP_SELL && openPrice <= 0)      return(error(ERR_INVALID_PARAMETER, "invalid parameter openPrice: %f (not positive)", openPrice));
+   if (stopLoss < 0)                          return(error(ERR_INVALID_PARAMETER, "invalid parameter stopLoss: %f (negative)", stopLoss));
+   if (takeProfit < 0)                        return(error(ERR_INVALID_PARAMETER, "invalid parameter takeProfit: %f (negative)", takeProfit));
+
+   TRIGGER_BOOK* book = GetTriggerBook(ec->pid, TRUE);
+   Trigger_RemoveLevels(book, ticket);
+
+   switch (type) {
+      case OP_BUY:
+         if (stopLoss)   Trigger_AddLevel(book, book->bidFalling, stopLoss,   ticket, TRIGGER_STOPLOSS);
+         if (takeProfit) Trigger_AddLevel(book, book->bidRising,  takeProfit, ticket, TRIGGER_TAKEPROFIT);
+         break;
+      case OP_SELL:
+         if (stopLoss)   Trigger_AddLevel(book, book->askRising,  stopLoss,   ticket, TRIGGER_STOPLOSS);
+         if (takeProfit) Trigger_AddLevel(book, book->askFalling, takeProfit, ticket, TRIGGER_TAKEPROFIT);
+         break;
+      case OP_BUYLIMIT:  Trigger_AddLevel(book, book->askFalling, openPrice,  ticket, TRIGGER_OPEN); break;
+      case OP_BUYSTOP:   Trigger_AddLevel(book, book->askRising,  openPrice,  ticket, TRIGGER_OPEN); break;
+      case OP_SELLLIMIT: Trigger_AddLevel(book, book->bidRising,  openPrice,  ticket, TRIGGER_OPEN); break;
+      case OP_SELLSTOP:  Trigger_AddLevel(book, book->bidFalling, openPrice,  ticket, TRIGGER_OPEN); break;
+   }
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Remove all trigger levels of an order, e.g. after the order was closed or deleted by the program itself.
+ *
+ * @param  EXECUTION_CONTEXT* ec     - execution context of the calling program
+ * @param  int                ticket - order ticket
+ *
+ * @return BOOL - success status (removing a ticket without registered levels is not an error)
+ */
+BOOL WINAPI Trigger_RemoveOrder(const EXECUTION_CONTEXT* ec, int ticket) {
+   if ((uint)ec < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec));
+   if (!ec->pid)                     return(error(ERR_INVALID_PARAMETER, "invalid execution context (ec.pid=0):  ec=%s", EXECUTION_CONTEXT_toStr(ec)));
+   if (ticket <= 0)                  return(error(ERR_INVALID_PARAMETER, "invalid parameter ticket: %d", ticket));
+
+   if (TRIGGER_BOOK* book = GetTriggerBook(ec->pid))
+      Trigger_RemoveLevels(book, ticket);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Get the trigger events of the last processed tick. Triggered levels are removed from the trigger book. A triggered
+ * position stoploss or takeprofit also removes the opposite level of the same ticket.
+ *
+ * @param  EXECUTION_CONTEXT* ec       - execution context of the calling program
+ * @param  int                tickets  - array receiving the tickets of the triggered orders
+ * @param  int                events   - array receiving the trigger events: TRIGGER_OPEN | TRIGGER_STOPLOSS | TRIGGER_TAKEPROFIT
+ * @param  int                size     - size of the passed arrays (may be 0 to query the number of events only)
+ *
+ * @return int - number of trigger events of the last tick (may be greater than the array size) or EMPTY (-1) in case of
+ *               errors
+ */
+int WINAPI Trigger_GetTriggered(const EXECUTION_CONTEXT* ec, int tickets[], int events[], int size) {
+   if ((uint)ec < MIN_VALID_POINTER)                    return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
+   if (!ec->pid)                                        return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid execution context (ec.pid=0):  ec=%s", EXECUTION_CONTEXT_toStr(ec))));
+   if (size < 0)                                        return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size: %d", size)));
+   if (size && (uint)tickets < MIN_VALID_POINTER)       return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter tickets: 0x%p (not a valid pointer)", tickets)));
+   if (size && (uint)events  < MIN_VALID_POINTER)       return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter events: 0x%p (not a valid pointer)", events)));
+
+   TRIGGER_BOOK* book = GetTriggerBook(ec->pid);
+   if (!book) return(0);
+
+   TriggerList &triggered = book->triggered;
+   int count = triggered.size();
+
+   for (int i=0; i < count && i < size; ++i) {
+      tickets[i] = triggered[i].ticket;
+      events [i] = triggered[i].event;
+   }
+   return(count);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Process a new tick: collect all levels of a program's trigger book crossed by the tick's prices. Levels within half a
+ * point of the current price count as crossed. Called from SyncMainContext_start().
+ *
+ * @param  uint   pid   - MQL program id
+ * @param  double bid   - Bid price of the tick
+ * @param  double ask   - Ask price of the tick
+ * @param  double point - point size of the symbol
+ *
+ * @return BOOL - whether levels were triggered
+ */
+BOOL WINAPI Trigger_onTick(uint pid, double bid, double ask, double point) {
+   TRIGGER_BOOK* book = GetTriggerBook(pid);
+   if (!book) return(FALSE);
+
+   TriggerList &triggered = book->triggered;
+   triggered.clear();                                             // keeps the capacity
+   if (book->tickets.empty()) return(FALSE);
+
+   double tolerance = point/2;
+   TriggerLevels::iterator it, end;
+
+   // falling prices trigger all levels at or above the price, rising prices all levels at or below the price
+   for (it=book->bidFalling.lower_bound(bid - tolerance), end=book->bidFalling.end();   it != end; ++it) triggered.push_back(it->second);
+   for (it=book->bidRising.begin(), end=book->bidRising.upper_bound(bid + tolerance);   it != end; ++it) triggered.push_back(it->second);
+   for (it=book->askFalling.lower_bound(ask - tolerance), end=book->askFalling.end();   it != end; ++it) triggered.push_back(it->second);
+   for (it=book->askRising.begin(), end=book->askRising.upper_bound(ask + tolerance);   it != end; ++it) triggered.push_back(it->second);
+
+   // remove the triggered tickets from the book, a ticket already removed was triggered twice (both SL and TP crossed)
+   uint size = triggered.size(), n = 0;
+   for (uint i=0; i < size; ++i) {
+      if (Trigger_RemoveLevels(book, triggered[i].ticket))
+         triggered[n++] = triggered[i];
+   }
+   triggered.resize(n);
+
+   return(n > 0);
+}
+
+
+/**
+ * Release the trigger book of an MQL program (if any).
+ *
+ * @param  uint pid - MQL program id
+ */
+void WINAPI ReleaseTriggerBook(uint pid) {
+   if (!TryEnterCriticalSection(&g_terminalMutex)) {
+      debugIn(DIAG_LOCK, "waiting to aquire lock on g_terminalMutex...");
+      EnterCriticalSection(&g_terminalMutex);
+   }
+   std::map<uint, TRIGGER_BOOK*>::iterator it = g_triggerBooks.find(pid);
+   if (it != g_triggerBooks.end()) {
+      Program_SetTriggerBook(pid, NULL);
+      delete it->second;
+      g_triggerBooks.erase(it);
+   }
+   LeaveCriticalSection(&g_terminalMutex);
+}
+
+
+/**
+ * Release all trigger books. Called only in DLL::onProcessDetach().
+ */
+void WINAPI ReleaseTriggerBooks() {
+   for (std::map<uint, TRIGGER_BOOK*>::iterator it=g_triggerBooks.begin(), end=g_triggerBooks.end(); it != end; ++it) {
+      delete it->second;
+   }
+   g_triggerBooks.clear();
+}
@@ -3,6 +3,7 @@
 #include "lib/datetime.h"
 #include "lib/helper.h"
 #include "lib/log.h"
+#include "lib/logwriter.h"
 #include "lib/memory.h"
 #include "lib/string.h"
 #include "struct/rsf/ExecutionContext.h"
@@ -982,6 +983,146 @@ const char* WINAPI ec_LogFilename(const EXECUTION_CONTEXT* ec) {
 }
 
 
+/**
+ * Copy a set of an MQL program's context values to a caller-provided array. Replaces a series of single getter calls by one
+ * DLL call (e.g. in init()).
+ *
+ * @param  EXECUTION_CONTEXT* ec
+ * @param  int                version - version of the field list the caller was compiled with: ECV_VERSION
+ * @param  int                fields  - ids of the fields to copy: ECV_PID...ECV_LOGLEVELSMS
+ * @param  double             values  - array receiving the field values in the order of the ids (MQL: double[size])
+ * @param  int                size    - number of fields to copy
+ *
+ * @return int - number of copied values or EMPTY (-1) in case of errors
+ */
+int WINAPI ec_GetValues(const EXECUTION_CONTEXT* ec, int version, const int fields[], double values[], int size) {
+   if ((uint)ec < MIN_VALID_POINTER)         return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
+   if (version < 1 || version > ECV_VERSION) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter version: %d (supported: 1...%d)", version, ECV_VERSION)));
+   if (size < 0)                             return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size: %d", size)));
+   if (!size)                                return(0);
+   if ((uint)fields < MIN_VALID_POINTER)     return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter fields: 0x%p (not a valid pointer)", fields)));
+   if ((uint)values < MIN_VALID_POINTER)     return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter values: 0x%p (not a valid pointer)", values)));
+
+   for (int i=0; i < size; ++i) {
+      double value;
+      switch (fields[i]) {
+         case ECV_PID                : value = ec->pid;                 break;
+         case ECV_PREVIOUSPID        : value = ec->previousPid;         break;
+         case ECV_PROGRAMTYPE        : value = ec->programType;         break;
+         case ECV_PROGRAMCOREFUNCTION: value = ec->programCoreFunction; break;
+         case ECV_PROGRAMINITREASON  : value = ec->programInitReason;   break;
+         case ECV_PROGRAMUNINITREASON: value = ec->programUninitReason; break;
+         case ECV_PROGRAMINITFLAGS   : value = ec->programInitFlags;    break;
+         case ECV_PROGRAMDEINITFLAGS : value = ec->programDeinitFlags;  break;
+         case ECV_MODULETYPE         : value = ec->moduleType;          break;
+         case ECV_MODULECOREFUNCTION : value = ec->moduleCoreFunction;  break;
+         case ECV_MODULEUNINITREASON : value = ec->moduleUninitReason;  break;
+         case ECV_MODULEINITFLAGS    : value = ec->moduleInitFlags;     break;
+         case ECV_MODULEDEINITFLAGS  : value = ec->moduleDeinitFlags;   break;
+         case ECV_TIMEFRAME          : value = ec->timeframe;           break;
+         case ECV_BARS               : value = ec->bars;                break;
+         case ECV_CHANGEDBARS        : value = ec->changedBars;         break;
+         case ECV_UNCHANGEDBARS      : value = ec->unchangedBars;       break;
+         case ECV_TICKS              : value = ec->ticks;               break;
+         case ECV_CYCLETICKS         : value = ec->cycleTicks;          break;
+         case ECV_PREVTICKTIME       : value = ec->prevTickTime;        break;
+         case ECV_CURRTICKTIME       : value = ec->currTickTime;        break;
+         case ECV_BID                : value = ec->bid;                 break;
+         case ECV_ASK                : value = ec->ask;                 break;
+         case ECV_DIGITS             : value = ec->digits;              break;
+         case ECV_PIPDIGITS          : value = ec->pipDigits;           break;
+         case ECV_SUBPIPDIGITS       : value = ec->subPipDigits;        break;
+         case ECV_PIP                : value = ec->pip;                 break;
+         case ECV_POINT              : value = ec->point;               break;
+         case ECV_PIPPOINTS          : value = ec->pipPoints;           break;
+         case ECV_THREADID           : value = ec->threadId;            break;
+         case ECV_HCHART             : value = (uint)ec->hChart;        break;
+         case ECV_HCHARTWINDOW       : value = (uint)ec->hChartWindow;  break;
+         case ECV_TESTING            : value = ec->testing;             break;
+         case ECV_VISUALMODE         : value = ec->visualMode;          break;
+         case ECV_OPTIMIZATION       : value = ec->optimization;        break;
+         case ECV_EXTREPORTING       : value = ec->extReporting;        break;
+         case ECV_RECORDEQUITY       : value = ec->recordEquity;        break;
+         case ECV_MQLERROR           : value = ec->mqlError;            break;
+         case ECV_DLLERROR           : value = ec->dllError;            break;
+         case ECV_DLLWARNING         : value = ec->dllWarning;          break;
+         case ECV_LOGLEVEL           : value = ec->loglevel;            break;
+         case ECV_LOGLEVELTERMINAL   : value = ec->loglevelTerminal;    break;
+         case ECV_LOGLEVELALERT      : value = ec->loglevelAlert;       break;
+         case ECV_LOGLEVELDEBUGGER   : value = ec->loglevelDebugger;    break;
+         case ECV_LOGLEVELFILE       : value = ec->loglevelFile;        break;
+         case ECV_LOGLEVELMAIL       : value = ec->loglevelMail;        break;
+         case ECV_LOGLEVELSMS        : value = ec->loglevelSMS;         break;
+         default:
+            return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter fields[%d]: %d (not a field id)", i, fields[i])));
+      }
+      values[i] = value;
+   }
+   return(size);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Copy a set of an MQL program's test values and statistics to a caller-provided array. Replaces a series of single getter
+ * calls by one DLL call. If the program is not under test all values are set to 0 (zero).
+ *
+ * @param  EXECUTION_CONTEXT* ec
+ * @param  int                version - version of the field list the caller was compiled with: TESTV_VERSION
+ * @param  int                fields  - ids of the fields to copy: TESTV_ID...TESTV_AVGSHORTPLPIP
+ * @param  double             values  - array receiving the field values in the order of the ids (MQL: double[size])
+ * @param  int                size    - number of fields to copy
+ *
+ * @return int - number of copied values or EMPTY (-1) in case of errors
+ */
+int WINAPI ec_GetTestValues(const EXECUTION_CONTEXT* ec, int version, const int fields[], double values[], int size) {
+   if ((uint)ec < MIN_VALID_POINTER)           return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter ec: 0x%p (not a valid pointer)", ec)));
+   if (version < 1 || version > TESTV_VERSION) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter version: %d (supported: 1...%d)", version, TESTV_VERSION)));
+   if (size < 0)                               return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size: %d", size)));
+   if (!size)                                  return(0);
+   if ((uint)fields < MIN_VALID_POINTER)       return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter fields: 0x%p (not a valid pointer)", fields)));
+   if ((uint)values < MIN_VALID_POINTER)       return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter values: 0x%p (not a valid pointer)", values)));
+
+   const TEST* test = ec->test;
+
+   for (int i=0; i < size; ++i) {
+      if ((uint)fields[i] > TESTV_AVGSHORTPLPIP) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter fields[%d]: %d (not a field id)", i, fields[i])));
+      double value = 0;
+
+      if (test) switch (fields[i]) {
+         case TESTV_ID                  : value = test->id;                                                             break;
+         case TESTV_CREATED             : value = test->created;                                                        break;
+         case TESTV_STARTTIME           : value = test->startTime;                                                      break;
+         case TESTV_ENDTIME             : value = test->endTime;                                                        break;
+         case TESTV_BARMODEL            : value = test->barModel;                                                       break;
+         case TESTV_BARS                : value = test->bars;                                                           break;
+         case TESTV_TICKS               : value = test->ticks;                                                          break;
+         case TESTV_SPREAD              : value = test->spread;                                                         break;
+         case TESTV_TRADEDIRECTIONS     : value = test->tradeDirections;                                                break;
+         case TESTV_REPORTID            : value = test->reportId;                                                       break;
+         case TESTV_OPENPOSITIONS       : value = test->openPositions        ? test->openPositions->size()        : 0; break;
+         case TESTV_OPENLONGPOSITIONS   : value = test->openLongPositions    ? test->openLongPositions->size()    : 0; break;
+         case TESTV_OPENSHORTPOSITIONS  : value = test->openShortPositions   ? test->openShortPositions->size()   : 0; break;
+         case TESTV_CLOSEDPOSITIONS     : value = test->closedPositions      ? test->closedPositions->size()      : 0; break;
+         case TESTV_CLOSEDLONGPOSITIONS : value = test->closedLongPositions  ? test->closedLongPositions->size()  : 0; break;
+         case TESTV_CLOSEDSHORTPOSITIONS: value = test->closedShortPositions ? test->closedShortPositions->size() : 0; break;
+         case TESTV_AVGRUNUPPIP         : value = test->stat_avgRunupPip;                                               break;
+         case TESTV_AVGLONGRUNUPPIP     : value = test->stat_avgLongRunupPip;                                           break;
+         case TESTV_AVGSHORTRUNUPPIP    : value = test->stat_avgShortRunupPip;                                          break;
+         case TESTV_AVGDRAWDOWNPIP      : value = test->stat_avgDrawdownPip;                                            break;
+         case TESTV_AVGLONGDRAWDOWNPIP  : value = test->stat_avgLongDrawdownPip;                                        break;
+         case TESTV_AVGSHORTDRAWDOWNPIP : value = test->stat_avgShortDrawdownPip;                                       break;
+         case TESTV_AVGPLPIP            : value = test->stat_avgPlPip;                                                  break;
+         case TESTV_AVGLONGPLPIP        : value = test->stat_avgLongPlPip;                                              break;
+         case TESTV_AVGSHORTPLPIP       : value = test->stat_avgShortPlPip;                                             break;
+      }
+      values[i] = value;
+   }
+   return(size);
+   #pragma EXPANDER_EXPORT
+}
+
+
 /**
  * Set an EXECUTION_CONTEXT's programType value.
  *
@@ -1982,6 +2123,7 @@ int WINAPI ec_SetLoglevel(EXECUTION_CONTEXT* ec, int level) {
 
             if (!master->loglevel || master->loglevel==LOG_OFF) {
                if (master->logger && master->logger->is_open()) {
+                  LogWriter_Flush();                                       // write queued entries before closing
                   master->logger->close();                                 // close an open logfile if logging was disabled
                }
             }
@@ -2084,6 +2226,7 @@ int WINAPI ec_SetLoglevelFile(EXECUTION_CONTEXT* ec, int level) {
 
             if (!master->loglevelFile || master->loglevelFile==LOG_OFF) {
                if (master->logger && master->logger->is_open()) {
+                  LogWriter_Flush();                                       // write queued entries before closing
                   master->logger->close();                                 // close an open logfile if the logfile appender was disabled
                }
             }
@@ -2262,6 +2405,7 @@ const char* WINAPI EXECUTION_CONTEXT_toStr(const EXECUTION_CONTEXT* ec) {
          << "}";
    }
    ss << StrFormat(" (0x%p)", ec);
+   HotPath_CountAllocation();                                           // strdup() bypasses the counting operator new
    char* result = strdup(ss.str().c_str());                             // TODO: add to GC (close memory leak)
 
    return(result);
@@ -7,6 +7,8 @@
 #include "struct/rsf/Order.h"
 #include "struct/rsf/Test.h"
 
+#include <algorithm>
+
 
 /**
  * Return a human-readable version of an ORDER.
@@ -45,12 +47,94 @@ char* WINAPI ORDER_toStr(const ORDER* order, BOOL outputDebug/*=FALSE*/) {
          << ", magicNumber=" <<                         order->magicNumber
          << ", comment="     <<          DoubleQuoteStr(order->comment)
          << ", runup="       << std::setprecision(1) << order->runupPip
+         << ", runupTime="   <<                        (order->runupTime    ? GmtTimeFormatA(order->runupTime, "\"%a, %d-%b-%Y %H:%M:%S\"") : "0")
          << ", drawdown="    << std::setprecision(1) << order->drawdownPip
+         << ", drawdownTime="<<                        (order->drawdownTime ? GmtTimeFormatA(order->drawdownTime, "\"%a, %d-%b-%Y %H:%M:%S\"") : "0")
+         << ", retrace="     << std::setprecision(1) << order->retracePip
          << ", result="      << std::setprecision(1) << order->plPip
          << "}";
    }
    char* result = strdup(ss.str().c_str());                          // TODO: add to GC (close memory leak)
 
-   if (outputDebug) debug(result);
+   if (outputDebug) notice(result);
    return(result);
 }
+
+
+/**
+ * Ordering predicate for closed positions: compares the close times of two orders.
+ */
+bool WINAPI ORDER_closedBefore(const ORDER* a, const ORDER* b) {
+   return(a->closeTime < b->closeTime);
+}
+
+
+/**
+ * Add a closed position to an ORDER_HISTORY and update the history's running totals.
+ *
+ * @param  ORDER_HISTORY* history
+ * @param  ORDER*         order   - closed position
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI ORDER_HISTORY_add(ORDER_HISTORY* history, ORDER* order) {
+   if ((uint)history < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter history: 0x%p (not a valid pointer)", history));
+   if ((uint)order   < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter order: 0x%p (not a valid pointer)", order));
+   if (!order->closeTime)                 return(error(ERR_INVALID_PARAMETER, "invalid parameter order: #%d (not closed)", order->ticket));
+
+   // Positions are closed in chronological order, so regularly this is an append. Orders with an equal closeTime keep
+   // their insertion order.
+   OrderList &orders = history->orders;
+   OrderList::iterator pos = std::upper_bound(orders.begin(), orders.end(), order, ORDER_closedBefore);
+   uint i = pos - orders.begin();
+   orders.insert(pos, order);
+
+   // recalculate the running totals starting at the insert position
+   uint size = orders.size();
+   history->totalProfit.resize(size);
+   history->totalPlPip .resize(size);
+
+   for (; i < size; ++i) {
+      ORDER* o = orders[i];
+      history->totalProfit[i] = (i ? history->totalProfit[i-1] : 0) + o->profit + o->swap + o->commission;
+      history->totalPlPip [i] = (i ? history->totalPlPip [i-1] : 0) + o->plPip;
+   }
+   return(TRUE);
+}
+
+
+/**
+ * Query the closed positions of an ORDER_HISTORY in the specified close time range.
+ *
+ * @param  ORDER_HISTORY* history
+ * @param  datetime       from              - start of the range (inclusive)
+ * @param  datetime       to                - end of the range (inclusive) or NULL (0) for no upper limit
+ * @param  double*        profit [optional] - variable receiving the net profit of the positions in the range
+ * @param  double*        plPip  [optional] - variable receiving the PL in pip of the positions in the range
+ *
+ * @return uint - number of closed positions in the range
+ */
+uint WINAPI ORDER_HISTORY_query(const ORDER_HISTORY* history, datetime from, datetime to, double* profit/*=NULL*/, double* plPip/*=NULL*/) {
+   if ((uint)history < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter history: 0x%p (not a valid pointer)", history));
+   if (profit) *profit = 0;
+   if (plPip)  *plPip  = 0;
+
+   const OrderList &orders = history->orders;
+   ORDER key = {};
+
+   uint first = 0, last = orders.size();
+
+   if (from > 0) {
+      key.closeTime = from - 1;
+      first = std::upper_bound(orders.begin(), orders.end(), &key, ORDER_closedBefore) - orders.begin();
+   }
+   if (to > 0) {
+      key.closeTime = to;
+      last = std::upper_bound(orders.begin(), orders.end(), &key, ORDER_closedBefore) - orders.begin();
+   }
+   if (first >= last) return(0);
+
+   if (profit) *profit = history->totalProfit[last-1] - (first ? history->totalProfit[first-1] : 0);
+   if (plPip)  *plPip  = history->totalPlPip [last-1] - (first ? history->totalPlPip [first-1] : 0);
+   return(last - first);
+}
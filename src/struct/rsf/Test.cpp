@@ -146,6 +146,47 @@ const char* WINAPI test_SetReportSymbol(TEST* test, const char* symbol) {
 }
 
 
+/**
+ * Release a TEST and all memory held by it (positions, position lists and history indexes, FXT header).
+ *
+ * @param  TEST* test
+ */
+void WINAPI TEST_release(TEST* test) {
+   if ((uint)test < MIN_VALID_POINTER) { error(ERR_INVALID_PARAMETER, "invalid parameter test: 0x%p (not a valid pointer)", test); return; }
+
+   OrderList* lists[] = { test->openPositions, test->closedPositions };   // the long/short lists hold the same orders
+   for (uint i=0; i < 2; ++i) {
+      if (OrderList* orders = lists[i]) {
+         for (OrderList::iterator it=orders->begin(), end=orders->end(); it != end; ++it) {
+            delete *it;
+         }
+      }
+   }
+   delete test->openPositions;
+   delete test->openLongPositions;
+   delete test->openShortPositions;
+   delete test->closedPositions;
+   delete test->closedLongPositions;
+   delete test->closedShortPositions;
+
+   delete test->closedHistory;
+   if (test->closedHistoryByMagic) {
+      for (OrderHistoryByMagic::iterator it=test->closedHistoryByMagic->begin(), end=test->closedHistoryByMagic->end(); it != end; ++it) {
+         delete it->second;
+      }
+      delete test->closedHistoryByMagic;
+   }
+   if (test->closedHistoryBySymbol) {
+      for (OrderHistoryBySymbol::iterator it=test->closedHistoryBySymbol->begin(), end=test->closedHistoryBySymbol->end(); it != end; ++it) {
+         delete it->second;
+      }
+      delete test->closedHistoryBySymbol;
+   }
+   delete test->fxtHeader;
+   delete test;
+}
+
+
 /**
  * Return a human-readable version of a TEST struct.
  *
@@ -196,6 +237,6 @@ char* WINAPI TEST_toStr(const TEST* test, BOOL outputDebug/*=FALSE*/) {
    }
    char* result = strdup(ss.str().c_str());                                         // TODO: add to GC (close memory leak)
 
-   if (outputDebug) debug(result);
+   if (outputDebug) notice(result);
    return(result);
 }